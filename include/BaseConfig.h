@@ -11,17 +11,24 @@ public:
   virtual bool load();
   virtual bool save();
   virtual void clear() = 0;
+  virtual uint16_t jsonSize() const { // Document capacity to hold whole config
+    return JSON_BUF_SIZE;
+  }
 
   virtual String toString();
   virtual bool fromString(const String &str);
 
-protected:
-  static const uint16_t JSON_BUF_SIZE = 1024;
+  bool merge(const char *json, size_t len, JsonDocument &doc, JsonArray changed, JsonArray rejected); // Current config with JSON merge patch applied, false if any key is rejected
+  void apply(const JsonDocument &doc) {
+    read(doc);
+  }
+  bool save(const JsonDocument &doc);
+
+  static const uint16_t JSON_BUF_SIZE = 2048;
 
+protected:
   virtual void read(const JsonDocument &doc) = 0;
   virtual void write(JsonDocument &doc) = 0;
 };
 
-bool initSPIFFS();
-
 #endif
@@ -1,7 +1,9 @@
 #ifndef __BUTTONS_H
 #define __BUTTONS_H
 
-#define ONE_BUTTON
+#if ! (defined(ONE_BUTTON) || defined(MULTI_BUTTON))
+#define ONE_BUTTON // Build with -DMULTI_BUTTON for several buttons and chords
+#endif
 
 #ifndef ONE_BUTTON
 #include "List.h"
@@ -12,17 +14,21 @@ struct __packed _button_t {
   uint8_t pin : 4;
   bool level : 1;
   bool paused : 1;
-  bool pressed : 1;
-  bool dblclickable : 1;
-  volatile uint16_t duration;
+  bool pressed : 1; // Debounced state
+  bool raw : 1; // State after last edge
+  bool held : 1; // Long click already reported
+  uint8_t clicks : 4; // Short clicks in current sequence
+  uint32_t rawtime; // Last edge
+  uint32_t time; // Last debounced press or release
 };
 
 const uint8_t EVT_BTNBASE = 0;
 
-enum buttonstate_t : uint8_t { BTN_RELEASED, BTN_PRESSED, BTN_CLICK, BTN_LONGCLICK, BTN_DBLCLICK };
+enum buttonstate_t : uint8_t { BTN_RELEASED, BTN_PRESSED, BTN_CLICK, BTN_LONGCLICK, BTN_DBLCLICK, BTN_MULTICLICK, BTN_CHORD };
 
 enum btneventid_t : uint8_t { EVT_BTNRELEASED = EVT_BTNBASE + BTN_RELEASED, EVT_BTNPRESSED = EVT_BTNBASE + BTN_PRESSED,
-  EVT_BTNCLICK = EVT_BTNBASE + BTN_CLICK, EVT_BTNLONGCLICK = EVT_BTNBASE + BTN_LONGCLICK, EVT_BTNDBLCLICK = EVT_BTNBASE + BTN_DBLCLICK };
+  EVT_BTNCLICK = EVT_BTNBASE + BTN_CLICK, EVT_BTNLONGCLICK = EVT_BTNBASE + BTN_LONGCLICK, EVT_BTNDBLCLICK = EVT_BTNBASE + BTN_DBLCLICK,
+  EVT_BTNMULTICLICK = EVT_BTNBASE + BTN_MULTICLICK, EVT_BTNCHORD = EVT_BTNBASE + BTN_CHORD };
 
 #ifdef ONE_BUTTON
 class Button {
@@ -32,42 +38,79 @@ public:
   void pause();
   void resume();
 #else
-class Buttons : public List<_button_t, 10> {
+class Buttons : public List<_button_t, 8> { // Chord mask must fit event data
 public:
-  Buttons(const EventQueue *events = NULL) : List<_button_t, 10>(), _isrtime(0), _events((EventQueue*)events) {}
+  Buttons(const EventQueue *events = NULL);
 
   uint8_t add(uint8_t pin, bool level);
   void pause(uint8_t index);
   void resume(uint8_t index);
+  void pause(); // All buttons
+  void resume();
 #endif
+  void update(); // Classify recorded edges, call from loop
+  uint32_t edgesLost() const {
+    return _edgelost;
+  }
 
 protected:
   static const uint8_t GPIO16_RENUM = 6; // Renum GPIO16 to unused GPIO6
+  static const uint8_t GPIO_COUNT = 17;
+  static const uint8_t NONE = 0xFF;
 
   static const uint16_t CLICK_TIME = 20; // 20 ms. debounce time
-  static const uint16_t LONGCLICK_TIME = 2000; // 2 sec.
-  static const uint16_t DBLCLICK_TIME = 500; // 0.5 sec.
+  static const uint16_t LONGCLICK_TIME = 2000; // 2 sec. of holding
+  static const uint16_t DBLCLICK_TIME = 500; // 0.5 sec. between clicks of sequence
+  static const uint8_t MAX_CLICKS = 15;
+  static const uint8_t EDGES_SIZE = 16; // Must be power of 2
+
+  struct __packed _edge_t {
+    uint32_t time;
+    uint8_t gpio;
+    bool high;
+  };
 
   static uint8_t pinToGpio(uint8_t pin) {
     return (pin == GPIO16_RENUM) ? 16 : pin;
   }
 #ifndef ONE_BUTTON
+  struct _pinarg_t { // Interrupt argument per GPIO
+    Buttons *owner;
+    uint8_t gpio;
+  };
+
   void cleanup(void *ptr);
   bool match(uint8_t index, const void *t);
+  void attach(uint8_t index);
+  bool chording() const;
 #endif
 
+  static void init(_button_t &b);
+  void edge(_button_t &b, uint8_t index, const _edge_t &e);
+  void settle(_button_t &b, uint8_t index, uint32_t time);
+  void timers(_button_t &b, uint8_t index, uint32_t time);
+  void pushEdge(uint8_t gpio, bool high);
+
 #ifdef ONE_BUTTON
   static void _isr(Button *_this);
-  virtual void onChange(buttonstate_t state);
+  virtual void onChange(buttonstate_t state, uint8_t clicks);
 #else
-  static void _isr(Buttons *_this);
-  virtual void onChange(buttonstate_t state, uint8_t button);
+  static void _isr(_pinarg_t *arg);
+  virtual void onChange(buttonstate_t state, uint8_t button, uint8_t clicks); // Chord passes mask of buttons as button
 #endif
 
 #ifdef ONE_BUTTON
   _button_t _item;
+#else
+  _pinarg_t _pinargs[GPIO_COUNT];
+  uint8_t _gpiomap[GPIO_COUNT]; // GPIO to button index
+  uint8_t _pressedmask;
+  uint8_t _chordmask; // Buttons pressed together since all were released
 #endif
-  uint32_t _isrtime;
+  _edge_t _edges[EDGES_SIZE]; // Filled by ISR only
+  volatile uint8_t _edgehead;
+  volatile uint8_t _edgetail;
+  volatile uint32_t _edgelost;
   EventQueue *_events;
 };
 
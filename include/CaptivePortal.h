@@ -3,33 +3,44 @@
 
 #ifdef ESP32
 #include <WiFi.h>
-#include <WebServer.h>
+#include <AsyncTCP.h>
 #else
 #include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
+#include <ESPAsyncTCP.h>
 #endif
+#include <ESPAsyncWebServer.h>
 #include <DNSServer.h>
 #include "Customization.h"
 #include "BaseConfig.h"
+#include "MqttOta.h" // otastate_t
 #ifdef USE_LED
 #include "Leds.h"
 #endif
 
+typedef void (*metricscb_t)(JsonDocument &doc);
+
 class CaptivePortal {
 public:
 #ifdef USE_LED
-  CaptivePortal(const BaseConfig *config, const Led *led) : _config((BaseConfig*)config), _led((Led*)led), _http(NULL), _dns(NULL) {}
+  CaptivePortal(const BaseConfig *config, const Led *led) : _config((BaseConfig*)config), _led((Led*)led), _http(NULL), _dns(NULL), _concurrent(false), _restartTime(0), _metrics(NULL), _otaRequest(NULL), _otaState(OTA_IDLE) {}
 #else
-  CaptivePortal(const BaseConfig *config) : _config((BaseConfig*)config), _http(NULL), _dns(NULL) {}
+  CaptivePortal(const BaseConfig *config) : _config((BaseConfig*)config), _http(NULL), _dns(NULL), _concurrent(false), _restartTime(0), _metrics(NULL), _otaRequest(NULL), _otaState(OTA_IDLE) {}
 #endif
   virtual ~CaptivePortal() {
-    if (_http)
-      delete[] _http;
-    if (_dns)
-      delete[] _dns;
+    end();
   }
 
-  virtual bool exec();
+  virtual bool exec(); // Blocking, AP mode only
+
+  virtual bool begin(bool concurrent = false); // Concurrent keeps STA mode, call process() from loop()
+  virtual bool process(); // false after CP_DURATION without AP clients
+  virtual void end();
+  bool active() const {
+    return _http != NULL;
+  }
+  void onMetrics(metricscb_t cb) { // Fills GET /api/metrics reply
+    _metrics = cb;
+  }
 
   virtual String ssid() const;
   virtual String password() const;
@@ -37,6 +48,10 @@ public:
 
 protected:
   static const uint32_t CP_DURATION = 45000; // 45 sec.
+  static const uint32_t RESTART_DELAY = 500; // Let reply leave before restart
+  static const uint16_t PAGE_FILES = 50; // Files per listing page
+  static const uint16_t UPLOAD_BLOCK = 1024; // Upload write size, multiple of flash page
+  static const uint32_t UPLOAD_RESERVE = 8192; // Free space filesystem needs for itself
 
 #ifdef USE_LED
   static const ledmode_t LED_CPWAITING = LED_2HZ;
@@ -44,41 +59,68 @@ protected:
 #endif
 
   virtual void cleanup();
+  virtual bool storeConfig(const String &json);
   virtual void restart();
 
   virtual void setupHandles();
 
-  virtual void handleNotFound();
-  virtual void handleCss();
-  virtual void handleRoot();
-  virtual void handleWriteConfig();
-  virtual void handleRestart();
-  virtual void handleSPIFFS();
-  virtual void handleFileUploaded();
-  virtual void handleFileUpload();
-  virtual void handleFileDelete();
-  virtual void handleFwUpdate();
-  virtual void handleSketchUpdated();
-  virtual void handleSketchUpdate();
+  virtual void handleNotFound(AsyncWebServerRequest *request);
+  virtual void handleCss(AsyncWebServerRequest *request);
+  virtual void handleRoot(AsyncWebServerRequest *request);
+  virtual void handleWriteConfig(AsyncWebServerRequest *request);
+  virtual void handleRestart(AsyncWebServerRequest *request);
+  virtual void handleSPIFFS(AsyncWebServerRequest *request);
+  virtual void handleFileUploaded(AsyncWebServerRequest *request);
+  virtual void handleFileUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final);
+  virtual void handleFileDelete(AsyncWebServerRequest *request);
+  virtual void handleFwUpdate(AsyncWebServerRequest *request);
+  virtual void handleSketchUpdated(AsyncWebServerRequest *request);
+  virtual void handleSketchUpdate(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final);
+  virtual void handleApiGetConfig(AsyncWebServerRequest *request);
+  virtual void handleApiPutConfig(AsyncWebServerRequest *request);
+  virtual void handleApiBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+  virtual void handleApiFiles(AsyncWebServerRequest *request);
+  virtual void handleApiMetrics(AsyncWebServerRequest *request);
+  virtual void handleApiUpdate(AsyncWebServerRequest *request);
+  virtual bool beginUpdate(AsyncWebServerRequest *request, const uint8_t *data, size_t len);
 #ifdef USE_AUTHORIZATION
-  virtual bool checkAuthorization();
+  virtual bool authorized(AsyncWebServerRequest *request); // Check only, for upload and body data
+  virtual bool checkAuthorization(AsyncWebServerRequest *request);
 #endif
-  virtual String getContentType(const String &fileName);
-  virtual bool handleFileRead(const String &path);
+  virtual String getContentType(AsyncWebServerRequest *request, const String &fileName);
+  virtual bool handleFileRead(AsyncWebServerRequest *request, const String &path);
   virtual String getCss();
+  virtual void sendJson(AsyncWebServerRequest *request, uint16_t code, const JsonDocument &doc);
+
+  virtual bool isCaptivePortal(AsyncWebServerRequest *request);
 
-  virtual bool isCaptivePortal();
+  class Gate : public AsyncWebHandler { // First handler to see every request
+  public:
+    Gate(CaptivePortal *portal) : _portal(portal) {}
+
+    bool canHandle(AsyncWebServerRequest *request); // Counts activity, claims requests not allowed to reach portal
+    void handleRequest(AsyncWebServerRequest *request);
+
+  protected:
+    CaptivePortal *_portal;
+  };
 
   BaseConfig *_config;
 #ifdef USE_LED
   Led *_led;
 #endif
-#ifdef ESP32
-  WebServer *_http;
-#else
-  ESP8266WebServer *_http;
-#endif
+  AsyncWebServer *_http;
   DNSServer *_dns;
+  bool _concurrent;
+  uint32_t _lastActivity;
+  uint32_t _restartTime; // Handlers run in TCP callbacks, restart is delayed to process()
+  metricscb_t _metrics;
+  AsyncWebServerRequest *_otaRequest; // Upload owning OTA state, others are refused
+  otastate_t _otaState;
+  bool _otaCompressed; // gzip image, unpacked by bootloader
+  PGM_P _otaError; // Own checks, Update keeps its error code
+  uint32_t _otaStart;
+  uint32_t _otaTime; // Upload duration, ms
 };
 
 #endif
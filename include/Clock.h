@@ -0,0 +1,42 @@
+#ifndef __CLOCK_H
+#define __CLOCK_H
+
+#include <Arduino.h>
+
+class Clock {
+public:
+  static const uint32_t SLEW_PERIOD = 60000; // Small corrections spread over 60 sec.
+  static const uint32_t STEP_LIMIT = 1000; // Larger corrections applied at once
+
+  Clock() : _offset(0), _error(0), _slewstart(0), _drift(0), _syncs(0) {}
+
+  static uint64_t monotonic() { // us since boot
+    return micros64();
+  }
+  void begin(const char *server);
+  void sync(); // Called when SNTP sets system time
+  bool synced() const {
+    return _syncs != 0;
+  }
+  uint64_t now() const; // ms since epoch, ms since boot until synced
+  uint64_t toWall(uint64_t mono) const; // Monotonic us to now() scale
+  int32_t drift() const { // Last correction, ms
+    return _drift;
+  }
+  uint16_t syncs() const {
+    return _syncs;
+  }
+
+protected:
+  int64_t offset(uint64_t ms) const;
+
+  int64_t _offset;
+  int32_t _error;
+  uint64_t _slewstart;
+  int32_t _drift;
+  uint16_t _syncs;
+};
+
+extern Clock sysClock;
+
+#endif
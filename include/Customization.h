@@ -3,7 +3,11 @@
 
 #define USE_SERIAL // Use UART for output
 #define USE_LED // Use led for visualization
+#define LOG_LEVEL LOG_LEVEL_INFO // Compile-time log level (LOG_LEVEL_NONE..LOG_LEVEL_DEBUG)
+//#define LOG_UART1 // Duplicate log to UART1 TX (GPIO2, shared with led!)
 //#define USE_AUTHORIZATION // Use web page basic authorization
+//#define USE_LITTLEFS // LittleFS instead of SPIFFS (formats existing SPIFFS data on first start!)
+//#define FS_BENCHMARK 300 // Log filesystem create/open/list time with given number of files on start
 
 #ifdef USE_AUTHORIZATION
 #define AUTH_USER "ESP" // User name for basic authorization
@@ -0,0 +1,52 @@
+#ifndef __DEDUP_H
+#define __DEDUP_H
+
+#include <inttypes.h>
+
+enum dedupmode_t : uint8_t { DEDUP_OFF, DEDUP_GLOBAL, DEDUP_TOPIC };
+
+class Dedup {
+public:
+  Dedup(dedupmode_t mode = DEDUP_OFF, uint16_t window = 1000) : _mode(mode), _window(window), _suppressed(0) {
+    clear();
+  }
+
+  dedupmode_t getMode() const {
+    return _mode;
+  }
+  void setMode(dedupmode_t mode) {
+    _mode = mode;
+    clear();
+  }
+  uint16_t getWindow() const {
+    return _window;
+  }
+  void setWindow(uint16_t window) {
+    _window = window;
+  }
+  uint32_t suppressed() const {
+    return _suppressed;
+  }
+  void clear();
+  bool isDuplicate(const char *code, uint8_t len, const char *topic = NULL); // Check only, refreshes window of repeated code
+  void remember(const char *code, uint8_t len, const char *topic = NULL); // Record after successful publish
+
+protected:
+  static const uint8_t SIZE = 32; // Must be power of 2
+  static const uint8_t MAX_PROBES = 8;
+
+  static uint32_t hash(const char *code, uint8_t len, const char *topic);
+  int8_t probe(uint32_t h, uint32_t now, uint8_t &victim) const; // Index of live entry or -1
+
+  struct __packed _dedup_t {
+    uint32_t hash;
+    uint32_t time;
+  };
+
+  dedupmode_t _mode;
+  uint16_t _window;
+  uint32_t _suppressed;
+  _dedup_t _items[SIZE];
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __FILESYSTEM_H
+#define __FILESYSTEM_H
+
+#include "Customization.h"
+#ifdef USE_LITTLEFS
+#include <LittleFS.h>
+#define FILESYSTEM LittleFS
+#define FILESYSTEM_NAME "LittleFS"
+#else
+#ifdef ESP32
+#include <SPIFFS.h>
+#else
+#include <FS.h>
+#endif
+#define FILESYSTEM SPIFFS
+#define FILESYSTEM_NAME "SPIFFS"
+#endif
+
+class FSDir { // Files of one directory, same on every backend and core
+public:
+  FSDir(const char *path);
+
+  bool next();
+  String name() const; // Without leading '/'
+  size_t size() const;
+
+protected:
+#ifdef ESP32
+  File _dir;
+  File _file;
+#else
+  Dir _dir;
+#endif
+};
+
+bool initFS(); // Mounts FILESYSTEM, formats it if mount fails
+bool infoFS(uint32_t &total, uint32_t &used);
+#ifdef FS_BENCHMARK
+void benchmarkFS(uint16_t files);
+#endif
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __GM65_H
+#define __GM65_H
+
+#include <Arduino.h>
+
+enum gm65mode_t : uint8_t { GM65_MANUAL, GM65_COMMAND, GM65_CONTINUOUS, GM65_INDUCTION, GM65_KEEP = 0xFF };
+
+enum gm65tail_t : uint8_t { GM65_TAIL_CR, GM65_TAIL_CRLF, GM65_TAIL_TAB, GM65_TAIL_NONE, GM65_TAIL_KEEP = 0xFF };
+
+// Serial command protocol of the GM65 module (see "GM65 Barcode reader mudule User Manual.pdf")
+class GM65 {
+public:
+  GM65(HardwareSerial &serial) : _serial(serial), _baud(9600) {}
+
+  uint32_t baud() const {
+    return _baud;
+  }
+  bool begin(uint32_t baud); // Finds scanner on host baud rate or factory 9600 and switches both to baud
+  bool setMode(gm65mode_t mode);
+  bool setTail(gm65tail_t tail);
+  bool setCodeId(bool enable); // One letter symbology prefix, see classifyBarcode(CLASSIFY_CODE_ID)
+  bool enableSymbologies(uint16_t mask); // Bit per symbology_t, 0 to keep scanner settings
+  bool save(); // Persist settings to scanner flash
+
+  bool readZone(uint16_t address, uint8_t *data, uint8_t len);
+  bool writeZone(uint16_t address, const uint8_t *data, uint8_t len);
+
+  static uint16_t crc(const uint8_t *data, uint8_t len);
+
+protected:
+  static const uint8_t CMD_READ = 0x07;
+  static const uint8_t CMD_WRITE = 0x08;
+  static const uint8_t CMD_SAVE = 0x09;
+
+  static const uint16_t ZONE_SETTINGS = 0x0000; // Bits 1..0 - scan mode
+  static const uint16_t ZONE_BAUD = 0x002A; // 2 bytes LE, 3000000 / baud
+  static const uint16_t ZONE_SYMBOLOGIES = 0x002C; // Bits 2..1 - 00 disable all, 01 enable all
+  static const uint16_t ZONE_TAIL = 0x0060; // Bits 6..5 - tail type (00 CR, 01 CRLF, 10 TAB, 11 none), bit 2 - Code ID, bit 0 - allow tail
+
+  static const uint16_t TIMEOUT = 100; // 100 ms.
+
+  bool command(uint8_t type, uint16_t address, const uint8_t *data, uint8_t len, uint8_t *reply = NULL, uint8_t replylen = 0);
+  bool modifyZone(uint16_t address, uint8_t mask, uint8_t value);
+  bool probe();
+
+  HardwareSerial &_serial;
+  uint32_t _baud;
+};
+
+#endif
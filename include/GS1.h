@@ -0,0 +1,10 @@
+#ifndef __GS1_H
+#define __GS1_H
+
+#include <inttypes.h>
+#include "PayloadWriter.h"
+
+// Decodes GS1 element strings (FNC1 transmitted as <GS>) into key/value pairs of the writer's current map
+bool decodeGS1(const char *data, uint8_t len, PayloadWriter &writer);
+
+#endif
@@ -44,8 +44,8 @@ class StaticList {
 public:
   static const uint8_t ERR_INDEX = 0xFF;
 
-  List() : _count(0) {}
-  ~List() {
+  StaticList() : _count(0) {}
+  ~StaticList() {
     clear();
   }
 
@@ -0,0 +1,107 @@
+#ifndef __LOGGER_H
+#define __LOGGER_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "Customization.h"
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+enum loglevel_t : uint8_t { LOG_ERROR = LOG_LEVEL_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG };
+
+class LogSink {
+public:
+  virtual ~LogSink() {}
+
+  virtual bool ready(uint8_t len) { // Sink can take the line without blocking
+    return true;
+  }
+  virtual void write(loglevel_t level, const char *line, uint8_t len) = 0;
+};
+
+class SerialLogSink : public LogSink {
+public:
+  SerialLogSink(HardwareSerial &serial) : _serial(serial) {}
+
+  bool ready(uint8_t len);
+  void write(loglevel_t level, const char *line, uint8_t len);
+
+protected:
+  static const uint8_t TX_FIFO_SIZE = 128;
+
+  HardwareSerial &_serial;
+};
+
+class SyslogSink : public LogSink {
+public:
+  SyslogSink(const char *server, uint16_t port, const char *hostname) : _server(server), _port(port), _hostname(hostname) {}
+
+  void write(loglevel_t level, const char *line, uint8_t len);
+
+protected:
+  const char *_server;
+  uint16_t _port;
+  const char *_hostname;
+  WiFiUDP _udp;
+};
+
+class Logger {
+public:
+  Logger() : _head(0), _used(0), _dropped(0), _sinkcount(0) {}
+
+  bool addSink(LogSink *sink);
+  void printf_P(loglevel_t level, PGM_P fmt, ...);
+  void drain(uint8_t lines = 4); // Call from idle time
+  void flush(); // Blocking drain, before restart or halt
+  uint32_t dropped() const {
+    return _dropped;
+  }
+
+protected:
+  static const uint16_t RING_SIZE = 1024;
+  static const uint8_t LINE_SIZE = 128;
+  static const uint8_t MAX_SINKS = 4;
+
+  void put(const void *data, uint16_t len);
+  void get(uint16_t pos, void *data, uint16_t len) const;
+
+  char _ring[RING_SIZE]; // Records: level, length, text
+  uint16_t _head;
+  uint16_t _used;
+  uint32_t _dropped;
+  uint8_t _sinkcount;
+  LogSink *_sinks[MAX_SINKS];
+};
+
+extern Logger logger;
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(fmt, ...) logger.printf_P(LOG_ERROR, PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_E(fmt, ...)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(fmt, ...) logger.printf_P(LOG_WARN, PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_W(fmt, ...)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(fmt, ...) logger.printf_P(LOG_INFO, PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_I(fmt, ...)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(fmt, ...) logger.printf_P(LOG_DEBUG, PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_D(fmt, ...)
+#endif
+
+#endif
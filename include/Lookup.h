@@ -0,0 +1,74 @@
+#ifndef __LOOKUP_H
+#define __LOOKUP_H
+
+#include <FS.h>
+
+/*
+ * Index file (little endian) is a static B-tree, all sections aligned to page size:
+ * page 0 - header, then index levels from the root down (first key of every page of the level below),
+ * then data pages with sorted fixed size records. Keys and values are '\0' padded strings.
+ */
+class Lookup {
+public:
+  static const uint32_t MAGIC = 0x31584942; // "BIX1"
+  static const uint16_t MAX_PAGE_SIZE = 512;
+
+  Lookup() : _count(0), _reads(0), _tick(0) {
+    invalidate();
+  }
+  ~Lookup() {
+    end();
+  }
+
+  bool begin(const char *path);
+  void end();
+  bool opened() const {
+    return _count != 0;
+  }
+  uint32_t count() const {
+    return _count;
+  }
+  uint32_t reads() const {
+    return _reads;
+  }
+  uint16_t valueSize() const {
+    return _header.valuesize;
+  }
+  bool find(const char *key, uint8_t len, char *value); // value buffer must fit valueSize() + 1
+
+protected:
+  static const uint8_t CACHE_PAGES = 4;
+  static const uint16_t NO_PAGE = 0xFFFF;
+  static const uint8_t MAX_LEVELS = 8;
+
+  struct __packed _header_t {
+    uint32_t magic;
+    uint16_t pagesize;
+    uint8_t keysize;
+    uint8_t valuesize;
+    uint32_t count;
+  };
+
+  struct _cache_t {
+    uint16_t page;
+    uint16_t used; // LRU tick
+    uint8_t data[MAX_PAGE_SIZE];
+  };
+
+  void invalidate();
+  const uint8_t *page(uint16_t index);
+  int16_t search(const uint8_t *data, uint16_t count, uint8_t recsize, const uint8_t *key, bool exact);
+
+  File _file;
+  _header_t _header;
+  uint32_t _count;
+  uint16_t _pages[MAX_LEVELS + 1]; // Page count per level, 0 - data
+  uint16_t _starts[MAX_LEVELS + 1]; // First page per level
+  uint8_t _levels;
+  uint16_t _perpage;
+  uint32_t _reads;
+  uint16_t _tick;
+  _cache_t _cache[CACHE_PAGES];
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __MQTTOTA_H
+#define __MQTTOTA_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+enum otastate_t : uint8_t { OTA_IDLE, OTA_RUNNING, OTA_DONE, OTA_FAILED };
+
+/*
+ * Firmware image pushed over MQTT. <topic>/begin carries JSON {"size":N,"md5":"...","window":N},
+ * <topic>/data carries 4 bytes big endian image offset followed by image bytes.
+ * Device acks every window bytes, wrong offset and completion with its current offset,
+ * sender always continues from acked offset, so lost chunks and reconnects resume the image.
+ */
+class MqttOta {
+public:
+  static const uint16_t DEF_WINDOW = 4096;
+
+  MqttOta() : _state(OTA_IDLE), _error(0), _skip(false), _size(0), _offset(0), _time(0) {}
+
+  bool begin(const char *json, size_t len); // Returns true if ack is due
+  bool write(const uint8_t *data, size_t len, size_t index, size_t total); // Message fragment, returns true if ack is due
+  void abort();
+
+  otastate_t state() const {
+    return _state;
+  }
+  uint32_t offset() const {
+    return _offset;
+  }
+  uint16_t status(char *json, uint16_t size) const; // Ack payload
+
+protected:
+  static const uint8_t MD5_SIZE = 32;
+
+  void finish();
+
+  otastate_t _state;
+  uint8_t _error; // Update error code, 0xFF for own checks
+  bool _skip; // Current message does not continue image
+  char _md5[MD5_SIZE + 1];
+  uint32_t _size;
+  uint32_t _offset;
+  uint32_t _acked;
+  uint32_t _window;
+  uint32_t _start;
+  uint32_t _time; // Transfer duration, ms
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef __OUTPUT_H
+#define __OUTPUT_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include <ESPAsyncTCP.h>
+
+class OutputSink {
+public:
+  virtual ~OutputSink() {}
+
+  virtual bool ready() { // Can take next message without blocking
+    return true;
+  }
+  virtual bool send(const char *topic, const char *payload, uint16_t len, uint64_t framed) = 0; // false keeps message queued
+  virtual void process() {} // Idle time work
+};
+
+class UdpSink : public OutputSink { // Compact datagrams, see tools/udprecv.py
+public:
+  static const uint16_t LOCAL_PORT = 5001; // Acks come back here
+  static const uint16_t DATAGRAM_SIZE = 416;
+  static const uint32_t ACK_TIMEOUT = 20; // 20 ms.
+  static const uint8_t MAX_RETRIES = 3;
+
+  UdpSink(const char *server, uint16_t port, const char *id, bool ack);
+
+  bool ready();
+  bool send(const char *topic, const char *payload, uint16_t len, uint64_t framed);
+  void process();
+  uint32_t retries() const {
+    return _retries;
+  }
+  uint32_t lost() const { // Not acked after all retries
+    return _lost;
+  }
+
+protected:
+  static const uint8_t FLAG_ACK = 0x01;
+  static const uint8_t FLAG_SYNCED = 0x02;
+
+  bool transmit();
+
+  const char *_server;
+  const char *_id;
+  uint16_t _port;
+  bool _ack;
+  bool _listening;
+  uint8_t _tries; // Of datagram waiting for ack, 0 if none
+  uint16_t _length;
+  uint32_t _seq;
+  uint32_t _time;
+  uint32_t _retries;
+  uint32_t _lost;
+  WiFiUDP _udp;
+  uint8_t _datagram[DATAGRAM_SIZE];
+};
+
+class HttpSink : public OutputSink {
+public:
+  static const uint16_t BATCH_SIZE = 1024;
+  static const uint32_t BATCH_DELAY = 100; // 100 ms. to collect more scans
+  static const uint32_t RESPONSE_TIMEOUT = 5000; // 5 sec.
+
+  HttpSink(const char *url, uint8_t batch);
+  ~HttpSink();
+
+  bool ready();
+  bool send(const char *topic, const char *payload, uint16_t len, uint64_t framed);
+  void process();
+  uint32_t errors() const {
+    return _errors;
+  }
+
+protected:
+  enum httpstate_t : uint8_t { HTTP_DISCONNECTED, HTTP_CONNECTING, HTTP_IDLE, HTTP_HEADERS, HTTP_BODY, HTTP_CHUNKED, HTTP_EOF };
+
+  bool parseUrl(const char *url);
+  void post();
+  void done(bool success);
+  void parse(const char *data, size_t len);
+  bool line(char c); // Collects header or chunk size line, true when complete
+  void headers();
+
+  static void onConnect(void *arg, AsyncClient *client);
+  static void onDisconnect(void *arg, AsyncClient *client);
+  static void onData(void *arg, AsyncClient *client, void *data, size_t len);
+
+  AsyncClient _client;
+  char *_host;
+  char *_path;
+  uint16_t _port;
+  uint8_t _batch;
+  uint8_t _count;
+  bool _full; // Next payload did not fit, flush before taking more
+  bool _sized; // Content-Length received
+  bool _chunked; // Transfer-Encoding: chunked
+  bool _trailer; // Last chunk received, skipping trailer
+  httpstate_t _state;
+  uint16_t _bodylen;
+  uint16_t _status;
+  uint8_t _linelen;
+  uint32_t _remain; // Body or chunk bytes to skip
+  uint32_t _time; // First batched scan or request start
+  uint32_t _errors;
+  char _line[64];
+  char _body[BATCH_SIZE]; // Newline delimited payloads
+};
+
+class Dispatcher {
+public:
+  static const uint8_t MAX_SINKS = 3;
+  static const uint16_t QUEUE_SIZE = 1024;
+
+  Dispatcher() : _sinkcount(0) {}
+
+  bool addSink(OutputSink *sink);
+  uint8_t sinks() const {
+    return _sinkcount;
+  }
+  uint8_t publish(const char *topic, const char *payload, uint16_t len, uint64_t framed = 0); // Returns number of sinks queued to
+  void process(); // Call from loop
+  uint32_t dropped(uint8_t sink) const {
+    return _outputs[sink].dropped;
+  }
+
+protected:
+  struct __packed _header_t {
+    uint64_t framed;
+    uint16_t len;
+    uint8_t topiclen;
+  };
+
+  struct _output_t {
+    OutputSink *sink;
+    char *ring; // Records: header, topic, payload
+    uint16_t head;
+    uint16_t used;
+    uint32_t dropped;
+  };
+
+  static void put(_output_t &output, const void *data, uint16_t len);
+  static void get(const _output_t &output, uint16_t pos, void *data, uint16_t len);
+
+  _output_t _outputs[MAX_SINKS];
+  uint8_t _sinkcount;
+  char _record[QUEUE_SIZE - sizeof(_header_t) + 1]; // Topic with terminating zero and payload of largest queued record
+};
+
+#endif
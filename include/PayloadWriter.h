@@ -0,0 +1,51 @@
+#ifndef __PAYLOADWRITER_H
+#define __PAYLOADWRITER_H
+
+#include <inttypes.h>
+#include <pgmspace.h>
+
+enum payloadformat_t : uint8_t { PAYLOAD_RAW, PAYLOAD_JSON, PAYLOAD_CBOR };
+
+class PayloadWriter {
+public:
+  PayloadWriter(char *buf, uint16_t size, payloadformat_t format) : _buf(buf), _size(size), _length(0), _format(format), _depth(0), _first(0), _overflow(false) {}
+
+  payloadformat_t format() const {
+    return _format;
+  }
+  uint16_t length() const {
+    return _length;
+  }
+  bool overflow() const {
+    return _overflow;
+  }
+  const char *c_str(); // Terminates the buffer with '\0', not counted in length()
+
+  void beginMap(PGM_P key = NULL);
+  void endMap();
+  void add(PGM_P key, const char *value, uint8_t len, bool progmem = false);
+  void add(PGM_P key, uint64_t value);
+  void add(const char *key, uint8_t keylen, const char *value, uint8_t len);
+
+protected:
+  static const uint8_t CBOR_UINT = 0;
+  static const uint8_t CBOR_TEXT = 3;
+  static const uint8_t CBOR_MAP = 5;
+  static const uint8_t CBOR_BREAK = 0xFF;
+
+  void put(char c);
+  void put(const char *str, uint8_t len, bool progmem = false);
+  void putString(const char *str, uint8_t len, bool progmem = false);
+  void putKey(const char *key, uint8_t len, bool progmem);
+  void putHead(uint8_t major, uint64_t value);
+
+  char *_buf;
+  uint16_t _size;
+  uint16_t _length;
+  payloadformat_t _format;
+  uint8_t _depth;
+  uint8_t _first; // Bit per nesting level, JSON separator needed
+  bool _overflow;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef __ROUTER_H
+#define __ROUTER_H
+
+#include <ArduinoJson.h>
+#include "List.h"
+#include "Symbology.h"
+
+const symbology_t SYM_ANY = (symbology_t)0xFF;
+
+struct _route_t { // Not packed, pointers must stay aligned
+  char *prefix;
+  char *topic; // Source template with {client}, {symbology} and {prefix4} placeholders
+  char *compiled; // Template with {client} expanded and dynamic placeholders as marker bytes
+  uint8_t minlen;
+  uint8_t maxlen;
+  symbology_t symbology;
+  bool dynamic : 1;
+  uint8_t next; // Next route attached to the same trie node
+};
+
+class Router : public List<_route_t, 16> {
+public:
+  static const uint8_t MAX_ROUTES = 16;
+  static const uint8_t PREFIX_SIZE = 16; // All prefixes of MAX_ROUTES fit 8-bit trie node indexes
+  static const uint8_t TOPIC_SIZE = 128;
+  static const uint16_t JSON_SIZE = JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(5) + 40 + PREFIX_SIZE + TOPIC_SIZE + 16; // Route in config document: slots, keys and longest strings
+
+  Router() : List<_route_t, 16>(), _nodes(NULL), _nodecount(0) {}
+  ~Router() {
+    clear();
+  }
+
+  void clear();
+  uint8_t add(const char *prefix, uint8_t minlen, uint8_t maxlen, symbology_t symbology, const char *topic);
+  bool compile(const char *client);
+  uint8_t read(JsonArrayConst routes); // Returns number of skipped wrong routes
+  void write(JsonArray routes) const;
+  const char *route(const char *code, uint8_t len, symbology_t symbology, char *topic);
+
+protected:
+  static const uint8_t NONE = 0xFF;
+  static const char MARK_SYMBOLOGY = 0x01;
+  static const char MARK_PREFIX4 = 0x02;
+
+  struct __packed _node_t {
+    char ch;
+    uint8_t child;
+    uint8_t sibling;
+    uint8_t route; // First route ending at this node
+  };
+
+  void cleanup(void *ptr);
+
+  uint8_t findChild(uint8_t node, char ch) const;
+  char *compileTopic(const char *topic, const char *client);
+
+  _node_t *_nodes;
+  uint8_t _nodecount;
+};
+
+#endif
@@ -11,5 +11,6 @@ inline bool allocStr(char **str, const __FlashStringHelper *src);
 void disposeStr(char **str);
 
 char *byteToHex(char *out, uint8_t value);
+uint8_t hexToBytes(uint8_t *out, uint8_t size, const char *hex); // ':' and ' ' separators allowed, returns 0 on error
 
 #endif
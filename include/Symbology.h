@@ -0,0 +1,28 @@
+#ifndef __SYMBOLOGY_H
+#define __SYMBOLOGY_H
+
+#include <inttypes.h>
+#include <pgmspace.h>
+
+enum symbology_t : uint8_t { SYM_UNKNOWN, SYM_EAN8, SYM_EAN13, SYM_UPCA, SYM_UPCE, SYM_ITF14, SYM_ITF, SYM_CODE128, SYM_GS1_128,
+  SYM_CODE39, SYM_CODABAR, SYM_QR, SYM_DATAMATRIX, SYM_GS1_DATAMATRIX, SYM_PDF417 };
+
+const char GS1_FNC1 = 0x1D; // FNC1 is transmitted as <GS>
+
+struct __packed barcodeinfo_t {
+  symbology_t symbology;
+  uint8_t offset; // Data start (after AIM symbology identifier or GM65 Code ID)
+  uint8_t length; // Data length
+  bool valid;
+};
+
+const uint8_t CLASSIFY_GUESS = 0x01; // Unprefixed digits of EAN/UPC/ITF-14 length are taken as such and check digit verified
+const uint8_t CLASSIFY_CODE_ID = 0x02; // Every code starts with GM65 Code ID letter instead of AIM identifier
+
+bool classifyBarcode(const char *code, uint8_t len, barcodeinfo_t *info, uint8_t flags = 0);
+PGM_P symbologyName(symbology_t symbology);
+symbology_t symbologyFromName(const char *name);
+
+bool checkMod10(const char *digits, uint8_t len);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef __TRACER_H
+#define __TRACER_H
+
+#include <inttypes.h>
+
+class Histogram {
+public:
+  static const uint8_t BUCKETS = 16;
+  static const uint32_t BASE = 128; // Bucket i counts values below BASE << i us, last one the rest
+
+  Histogram() {
+    clear();
+  }
+
+  void clear();
+  void add(uint32_t us);
+  uint32_t operator[](uint8_t bucket) const {
+    return _buckets[bucket];
+  }
+  uint32_t count() const {
+    return _count;
+  }
+  uint32_t max() const {
+    return _max;
+  }
+
+protected:
+  uint32_t _buckets[BUCKETS];
+  uint32_t _count;
+  uint32_t _max;
+};
+
+class Tracer {
+public:
+  Tracer() : _lost(0) {
+    clear();
+  }
+
+  void clear(); // Forget packets in flight
+  void handoff(uint64_t framed, uint16_t packetId); // packetId 0 means no PUBACK expected
+  bool ack(uint16_t packetId);
+
+  const Histogram &publish() const { // Frame completion to publish hand-off
+    return _publish;
+  }
+  const Histogram &acked() const { // Publish hand-off to PUBACK
+    return _acked;
+  }
+  uint32_t lost() const { // In-flight entries evicted before ack
+    return _lost;
+  }
+
+protected:
+  static const uint8_t INFLIGHT = 8;
+
+  struct __packed _inflight_t {
+    uint16_t packetId;
+    uint32_t time;
+  };
+
+  Histogram _publish;
+  Histogram _acked;
+  _inflight_t _inflight[INFLIGHT];
+  uint8_t _next;
+  uint32_t _lost;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __TRANSFORM_H
+#define __TRANSFORM_H
+
+#include <inttypes.h>
+
+/*
+ * Source: operations separated by ';', arguments by spaces, escapes \s \t \r \n \; \\ \xHH
+ *   lstrip <str>        remove prefix if present
+ *   rstrip <str>        remove suffix if present
+ *   substr <pos> [len]  keep part of code
+ *   upper, lower        change case
+ *   remove <classes>    drop characters of classes (ctrl, space, alpha, digit, punct, high) joined by ','
+ *   keep <classes>      drop characters of other classes
+ *   replace <c> [<c>]   replace or delete single character
+ */
+class Transform {
+public:
+  static const uint8_t SIZE = 64;
+
+  Transform() {
+    clear();
+  }
+
+  void clear() {
+    _code[0] = OP_END;
+  }
+  bool empty() const {
+    return _code[0] == OP_END;
+  }
+  bool compile(const char *source); // false on error, transform is cleared
+  uint8_t apply(char *code, uint8_t len) const; // In place, returns new length
+
+protected:
+  enum opcode_t : uint8_t { OP_END, OP_LSTRIP, OP_RSTRIP, OP_SUBSTR, OP_UPPER, OP_LOWER, OP_REMOVE, OP_REPLACE, OP_DELETE };
+
+  static const uint8_t CLASS_CTRL = 0x01;
+  static const uint8_t CLASS_SPACE = 0x02;
+  static const uint8_t CLASS_ALPHA = 0x04;
+  static const uint8_t CLASS_DIGIT = 0x08;
+  static const uint8_t CLASS_PUNCT = 0x10;
+  static const uint8_t CLASS_HIGH = 0x20;
+
+  static uint8_t charClass(char c);
+  static const char *token(const char *source, char *out, uint8_t size, uint8_t *len);
+  static uint8_t parseClasses(const char *arg);
+  const char *compileOp(const char *source, uint8_t *pos);
+
+  uint8_t _code[SIZE];
+};
+
+#endif
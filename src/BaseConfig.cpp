@@ -1,9 +1,5 @@
-#ifdef ESP32
-#include <SPIFFS.h>
-#else
-#include <FS.h>
-#endif
 #include "BaseConfig.h"
+#include "FileSystem.h"
 
 bool BaseConfig::load() {
   char mode[2];
@@ -11,10 +7,10 @@ bool BaseConfig::load() {
   mode[0] = 'r';
   mode[1] = '\0';
 
-  File file = SPIFFS.open(FPSTR(CONFIG_FILE_NAME), mode);
+  File file = FILESYSTEM.open(FPSTR(CONFIG_FILE_NAME), mode);
 
   if (file) {
-    DynamicJsonDocument jsonDoc(JSON_BUF_SIZE);
+    DynamicJsonDocument jsonDoc(jsonSize());
     DeserializationError error = deserializeJson(jsonDoc, file);
 
     file.close();
@@ -29,18 +25,23 @@ bool BaseConfig::load() {
 }
 
 bool BaseConfig::save() {
+  DynamicJsonDocument jsonDoc(jsonSize());
+
+  write(jsonDoc);
+
+  return save(jsonDoc);
+}
+
+bool BaseConfig::save(const JsonDocument &doc) {
   char mode[2];
 
   mode[0] = 'w';
   mode[1] = '\0';
 
-  File file = SPIFFS.open(FPSTR(CONFIG_FILE_NAME), mode);
+  File file = FILESYSTEM.open(FPSTR(CONFIG_FILE_NAME), mode);
 
   if (file) {
-    DynamicJsonDocument jsonDoc(JSON_BUF_SIZE);
-
-    write(jsonDoc);
-    serializeJson(jsonDoc, file);
+    serializeJson(doc, file);
     file.close();
 
     return true;
@@ -51,7 +52,7 @@ bool BaseConfig::save() {
 
 String BaseConfig::toString() {
   String result;
-  DynamicJsonDocument jsonDoc(JSON_BUF_SIZE);
+  DynamicJsonDocument jsonDoc(jsonSize());
 
   write(jsonDoc);
   serializeJsonPretty(jsonDoc, result);
@@ -60,7 +61,7 @@ String BaseConfig::toString() {
 }
 
 bool BaseConfig::fromString(const String &str) {
-  DynamicJsonDocument jsonDoc(JSON_BUF_SIZE);
+  DynamicJsonDocument jsonDoc(jsonSize());
   DeserializationError error = deserializeJson(jsonDoc, str);
 
   if (! error) {
@@ -72,15 +73,30 @@ bool BaseConfig::fromString(const String &str) {
   return false;
 }
 
-bool initSPIFFS() {
-#ifdef ESP32
-  return SPIFFS.begin(true);
-#else
-  if (! SPIFFS.begin()) {
-    if ((! SPIFFS.format()) || (! SPIFFS.begin())) {
-      return false;
+static bool sameType(JsonVariantConst a, JsonVariantConst b) {
+  return (a.is<bool>() == b.is<bool>()) && (a.is<long>() == b.is<long>()) && (a.is<const char*>() == b.is<const char*>()) &&
+    (a.is<JsonArrayConst>() == b.is<JsonArrayConst>()) && (a.is<JsonObjectConst>() == b.is<JsonObjectConst>());
+}
+
+bool BaseConfig::merge(const char *json, size_t len, JsonDocument &doc, JsonArray changed, JsonArray rejected) {
+  DynamicJsonDocument patchDoc(jsonSize() / 2);
+
+  if (deserializeJson(patchDoc, json, len) || (! patchDoc.is<JsonObject>()))
+    return false;
+  write(doc);
+  for (JsonPair kv : patchDoc.as<JsonObject>()) {
+    if ((! doc.containsKey(kv.key())) || ((! kv.value().isNull()) && (! sameType(doc[kv.key()], kv.value())))) { // Unknown parameter or wrong type
+      rejected.add(kv.key());
+      continue;
+    }
+    if (kv.value().isNull()) { // Null resets parameter to default
+      doc.remove(kv.key());
+      changed.add(kv.key());
+    } else if (doc[kv.key()] != kv.value()) {
+      doc[kv.key()] = kv.value();
+      changed.add(kv.key());
     }
   }
-  return true;
-#endif
+
+  return (! rejected.size()) && (! doc.overflowed());
 }
@@ -1,17 +1,23 @@
-#include <functional>
-#include <FunctionalInterrupt.h>
+#include <Arduino.h>
 #include "Buttons.h"
 
 #ifdef ONE_BUTTON
-Button::Button(uint8_t pin, bool level, const EventQueue *events) : _isrtime(0), _events((EventQueue*)events) {
+Button::Button(uint8_t pin, bool level, const EventQueue *events) : _edgehead(0), _edgetail(0), _edgelost(0), _events((EventQueue*)events) {
   _item.pin = (pin == 16) ? GPIO16_RENUM : pin;
   _item.level = level;
   _item.paused = false;
-  _item.pressed = false;
-  _item.dblclickable = false;
-  _item.duration = 0;
+  init(_item);
   pinMode(pin, level ? INPUT : INPUT_PULLUP);
-  attachInterrupt(pin, [this]() { this->_isr(this); }, CHANGE);
+  attachInterruptArg(pin, (void (*)(void*))_isr, this, CHANGE);
+}
+#else
+Buttons::Buttons(const EventQueue *events) : List<_button_t, 8>(), _pressedmask(0), _chordmask(0), _edgehead(0), _edgetail(0), _edgelost(0),
+  _events((EventQueue*)events) {
+  for (uint8_t i = 0; i < GPIO_COUNT; ++i) {
+    _pinargs[i].owner = this;
+    _pinargs[i].gpio = i;
+    _gpiomap[i] = NONE;
+  }
 }
 #endif
 
@@ -26,17 +32,22 @@ uint8_t Buttons::add(uint8_t pin, bool level) {
   b.pin = (pin == 16) ? GPIO16_RENUM : pin;
   b.level = level;
   b.paused = false;
-  b.pressed = false;
-  b.dblclickable = false;
-  b.duration = 0;
-  result = List<_button_t, 10>::add(b);
+  init(b);
+  result = List<_button_t, 8>::add(b);
   if (result != ERR_INDEX) {
     pinMode(pin, level ? INPUT : INPUT_PULLUP);
-    attachInterrupt(pin, [this]() { this->_isr(this); }, CHANGE);
+    _gpiomap[pin] = result;
+    attach(result);
   }
 
   return result;
 }
+
+void Buttons::attach(uint8_t index) {
+  uint8_t gpio = pinToGpio(_items[index].pin);
+
+  attachInterruptArg(gpio, (void (*)(void*))_isr, &_pinargs[gpio], CHANGE);
+}
 #endif
 
 #ifdef ONE_BUTTON
@@ -51,119 +62,220 @@ void Buttons::pause(uint8_t index) {
     detachInterrupt(pinToGpio(_items[index].pin));
   }
 }
+
+void Buttons::pause() {
+  for (uint8_t i = 0; i < _count; ++i)
+    pause(i);
+}
 #endif
 
 #ifdef ONE_BUTTON
 void Button::resume() {
+  _edgetail = _edgehead;
   _item.paused = false;
-  _item.pressed = false;
-  _item.dblclickable = false;
-  _item.duration = 0;
-  attachInterrupt(pinToGpio(_item.pin), [this]() { this->_isr(this); }, CHANGE);
+  init(_item);
+  attachInterruptArg(pinToGpio(_item.pin), (void (*)(void*))_isr, this, CHANGE);
 }
 #else
 void Buttons::resume(uint8_t index) {
   if (_items && (index < _count)) {
     _items[index].paused = false;
-    _items[index].pressed = false;
-    _items[index].dblclickable = false;
-    _items[index].duration = 0;
-    attachInterrupt(pinToGpio(_items[index].pin), [this]() { this->_isr(this); }, CHANGE);
+    _pressedmask &= ~(1 << index);
+    _chordmask &= ~(1 << index);
+    init(_items[index]);
+    attach(index);
   }
 }
+
+void Buttons::resume() {
+  _edgetail = _edgehead;
+  for (uint8_t i = 0; i < _count; ++i)
+    resume(i);
+}
 #endif
 
 #ifdef ONE_BUTTON
-void ICACHE_RAM_ATTR Button::_isr(Button *_this) {
-  if (! _this->_item.paused) {
-    uint32_t time = millis() - _this->_isrtime;
-    uint32_t inputs = GPI;
-
-    if (_this->_item.duration) {
-      if (time + _this->_item.duration < 0xFFFF)
-        _this->_item.duration += time;
-      else
-        _this->_item.duration = 0xFFFF;
-    }
-    if (((inputs >> pinToGpio(_this->_item.pin)) & 0x01) == _this->_item.level) { // Button pressed
-      if (! _this->_item.pressed) {
-        _this->_item.dblclickable = (_this->_item.duration > 0) && (_this->_item.duration <= DBLCLICK_TIME);
-        _this->_item.pressed = true;
-        _this->_item.duration = 1;
-        _this->onChange(BTN_PRESSED);
-      }
-    } else { // Button released
-      if (_this->_item.pressed) { // Was pressed
-        if (_this->_item.duration >= LONGCLICK_TIME) {
-          _this->onChange(BTN_LONGCLICK);
-        } else if (_this->_item.duration >= CLICK_TIME) {
-          if (_this->_item.dblclickable)
-            _this->onChange(BTN_DBLCLICK);
-          else
-            _this->onChange(BTN_CLICK);
-        } else {
-          _this->onChange(BTN_RELEASED);
-        }
-        _this->_item.pressed = false;
-        if ((_this->_item.duration >= CLICK_TIME) && (_this->_item.duration < LONGCLICK_TIME))
-          _this->_item.duration = 1;
-        else
-          _this->_item.duration = 0;
+void Button::update() {
+#else
+void Buttons::update() {
+#endif
+  uint32_t now;
+
+  while (_edgetail != _edgehead) {
+    const _edge_t &e = _edges[_edgetail];
+
+#ifdef ONE_BUTTON
+    if (! _item.paused)
+      edge(_item, 0, e);
+#else
+    uint8_t index = _gpiomap[e.gpio];
+
+    if ((index >= _count) || (pinToGpio(_items[index].pin) != e.gpio)) { // List was compacted by remove()
+      for (index = 0; index < _count; ++index) {
+        if (pinToGpio(_items[index].pin) == e.gpio)
+          break;
       }
+      _gpiomap[e.gpio] = (index < _count) ? index : NONE;
+    }
+    if ((index < _count) && (! _items[index].paused))
+      edge(_items[index], index, e);
+#endif
+    _edgetail = (_edgetail + 1) & (EDGES_SIZE - 1);
+  }
+  now = millis();
+#ifdef ONE_BUTTON
+  if (! _item.paused) {
+    settle(_item, 0, now);
+    timers(_item, 0, now);
+  }
+#else
+  for (uint8_t i = 0; i < _count; ++i) {
+    if (! _items[i].paused) {
+      settle(_items[i], i, now);
+      timers(_items[i], i, now);
     }
   }
-  _this->_isrtime = millis();
-}
-#else
-void ICACHE_RAM_ATTR Buttons::_isr(Buttons *_this) {
-  if (_this->_items && _this->_count) {
-    uint32_t time = millis() - _this->_isrtime;
-    uint32_t inputs = GPI;
-
-    for (uint8_t i = 0; i < _this->_count; ++i) {
-      if (_this->_items[i].paused)
-        continue;
-      if (_this->_items[i].duration) {
-        if (time + _this->_items[i].duration < 0xFFFF)
-          _this->_items[i].duration += time;
-        else
-          _this->_items[i].duration = 0xFFFF;
-      }
-      if (((inputs >> pinToGpio(_this->_items[i].pin)) & 0x01) == _this->_items[i].level) { // Button pressed
-        if (! _this->_items[i].pressed) {
-          _this->_items[i].dblclickable = (_this->_items[i].duration > 0) && (_this->_items[i].duration <= DBLCLICK_TIME);
-          _this->_items[i].pressed = true;
-          _this->_items[i].duration = 1;
-          _this->onChange(BTN_PRESSED, i);
-        }
-      } else { // Button released
-        if (_this->_items[i].pressed) { // Was pressed
-          if (_this->_items[i].duration >= LONGCLICK_TIME) {
-            _this->onChange(BTN_LONGCLICK, i);
-          } else if (_this->_items[i].duration >= CLICK_TIME) {
-            if (_this->_items[i].dblclickable)
-              _this->onChange(BTN_DBLCLICK, i);
-            else
-              _this->onChange(BTN_CLICK, i);
-          } else {
-            _this->onChange(BTN_RELEASED, i);
-          }
-          _this->_items[i].pressed = false;
-          if ((_this->_items[i].duration >= CLICK_TIME) && (_this->_items[i].duration < LONGCLICK_TIME))
-            _this->_items[i].duration = 1;
-          else
-            _this->_items[i].duration = 0;
-        }
+#endif
+}
+
+#ifdef ONE_BUTTON
+void Button::init(_button_t &b) {
+#else
+void Buttons::init(_button_t &b) {
+#endif
+  b.pressed = false;
+  b.raw = false;
+  b.held = false;
+  b.clicks = 0;
+  b.rawtime = 0;
+  b.time = 0;
+}
+
+#ifdef ONE_BUTTON
+void Button::edge(_button_t &b, uint8_t index, const _edge_t &e) {
+#else
+void Buttons::edge(_button_t &b, uint8_t index, const _edge_t &e) {
+#endif
+  bool state = e.high == b.level;
+
+  settle(b, index, e.time); // Previous level lasted until this edge
+  if (state != b.raw) {
+    b.raw = state;
+    b.rawtime = e.time;
+  }
+}
+
+#ifdef ONE_BUTTON
+void Button::settle(_button_t &b, uint8_t index, uint32_t time) {
+#else
+void Buttons::settle(_button_t &b, uint8_t index, uint32_t time) {
+#endif
+  if ((b.raw != b.pressed) && (time - b.rawtime >= CLICK_TIME)) { // Stable long enough, not a bounce
+    timers(b, index, b.rawtime); // Sequence may have expired before this change
+    b.pressed = b.raw;
+    b.time = b.rawtime;
+    if (b.pressed) {
+      b.held = false;
+#ifdef ONE_BUTTON
+      onChange(BTN_PRESSED, 0);
+#else
+      _pressedmask |= 1 << index;
+      _chordmask |= 1 << index;
+      onChange(BTN_PRESSED, index, 0);
+#endif
+    } else {
+#ifdef ONE_BUTTON
+      if ((! b.held) && (b.clicks < MAX_CLICKS))
+        ++b.clicks;
+      onChange(BTN_RELEASED, 0);
+#else
+      _pressedmask &= ~(1 << index);
+      if (chording()) // Part of combination, not a click
+        b.clicks = 0;
+      else if ((! b.held) && (b.clicks < MAX_CLICKS))
+        ++b.clicks;
+      onChange(BTN_RELEASED, index, 0);
+      if (! _pressedmask) {
+        if (chording())
+          onChange(BTN_CHORD, _chordmask, 0);
+        _chordmask = 0;
       }
+#endif
     }
   }
-  _this->_isrtime = millis();
+}
+
+#ifdef ONE_BUTTON
+void Button::timers(_button_t &b, uint8_t, uint32_t time) { // Single button has no index
+#else
+void Buttons::timers(_button_t &b, uint8_t index, uint32_t time) {
+#endif
+  if (b.raw != b.pressed) // Level changed at rawtime, only not debounced yet
+    time = b.rawtime;
+  if (b.pressed) {
+#ifdef ONE_BUTTON
+    if ((! b.held) && (time - b.time >= LONGCLICK_TIME)) { // Fires while still holding
+#else
+    if ((! b.held) && (! chording()) && (time - b.time >= LONGCLICK_TIME)) { // Fires while still holding
+#endif
+      b.held = true;
+      b.clicks = 0;
+#ifdef ONE_BUTTON
+      onChange(BTN_LONGCLICK, 0);
+#else
+      onChange(BTN_LONGCLICK, index, 0);
+#endif
+    }
+  } else if (b.clicks && (time - b.time > DBLCLICK_TIME)) { // Sequence completed
+    buttonstate_t state = (b.clicks == 1) ? BTN_CLICK : (b.clicks == 2) ? BTN_DBLCLICK : BTN_MULTICLICK;
+
+#ifdef ONE_BUTTON
+    onChange(state, b.clicks);
+#else
+    onChange(state, index, b.clicks);
+#endif
+    b.clicks = 0;
+  }
+}
+
+#ifdef ONE_BUTTON
+void ICACHE_RAM_ATTR Button::pushEdge(uint8_t gpio, bool high) {
+#else
+void ICACHE_RAM_ATTR Buttons::pushEdge(uint8_t gpio, bool high) {
+#endif
+  uint8_t head = _edgehead;
+  uint8_t next = (head + 1) & (EDGES_SIZE - 1);
+
+  if (next == _edgetail) { // Loop is late, edge lost
+    ++_edgelost;
+    return;
+  }
+  _edges[head].time = millis();
+  _edges[head].gpio = gpio;
+  _edges[head].high = high;
+  _edgehead = next;
+}
+
+#ifdef ONE_BUTTON
+void ICACHE_RAM_ATTR Button::_isr(Button *_this) {
+  uint8_t gpio = pinToGpio(_this->_item.pin);
+
+  _this->pushEdge(gpio, (GPI >> gpio) & 0x01);
+}
+#else
+void ICACHE_RAM_ATTR Buttons::_isr(_pinarg_t *arg) { // Only GPIO that changed, no button scan
+  arg->owner->pushEdge(arg->gpio, (GPI >> arg->gpio) & 0x01);
 }
 #endif
 
 #ifndef ONE_BUTTON
 void Buttons::cleanup(void *ptr) {
-  detachInterrupt(pinToGpio(((_button_t*)ptr)->pin));
+  uint8_t gpio = pinToGpio(((_button_t*)ptr)->pin);
+
+  detachInterrupt(gpio);
+  _gpiomap[gpio] = NONE;
+  _pressedmask = 0;
+  _chordmask = 0;
 }
 
 bool Buttons::match(uint8_t index, const void *t) {
@@ -173,21 +285,28 @@ bool Buttons::match(uint8_t index, const void *t) {
 
   return false;
 }
+
+bool Buttons::chording() const {
+  return (_chordmask & (_chordmask - 1)) != 0; // Two or more buttons
+}
 #endif
 
 #ifdef ONE_BUTTON
-void Button::onChange(buttonstate_t state) {
+void Button::onChange(buttonstate_t state, uint8_t clicks) {
 #else
-void Buttons::onChange(buttonstate_t state, uint8_t button) {
+void Buttons::onChange(buttonstate_t state, uint8_t button, uint8_t clicks) {
 #endif
   if (_events) {
     event_t e;
 
     e.id = EVT_BTNBASE + state;
 #ifdef ONE_BUTTON
-    e.data = 0;
+    e.data = clicks;
 #else
-    e.data = button;
+    if (state == BTN_CHORD)
+      e.data = button; // Mask of buttons
+    else
+      e.data = (clicks << 4) | button; // Click count of multi click in high nibble
 #endif
     _events->put(&e, true);
   }
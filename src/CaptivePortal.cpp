@@ -1,11 +1,10 @@
 #ifdef ESP32
-#include <SPIFFS.h>
 #include <Update.h>
 #else
-#include <FS.h>
 #include <WiFiUdp.h>
 #endif
 #include "CaptivePortal.h"
+#include "FileSystem.h"
 #include "StrUtils.h"
 #include "HtmlHelper.h"
 
@@ -15,6 +14,11 @@ static const char CSS_URI[] PROGMEM = "/default.css";
 static const char RESTART_URI[] PROGMEM = "/restart";
 static const char SPIFFS_URI[] PROGMEM = "/spiffs";
 static const char FWUPDATE_URI[] PROGMEM = "/fwupdate";
+static const char API_CONFIG_URI[] PROGMEM = "/api/config";
+static const char API_FILES_URI[] PROGMEM = "/api/files";
+static const char API_METRICS_URI[] PROGMEM = "/api/metrics";
+static const char API_UPDATE_URI[] PROGMEM = "/api/update";
+static const char MD5_PARAM[] PROGMEM = "md5";
 
 static uint8_t wifiFindFreeChannel() {
   int32_t levels[MAX_WIFI_CHANNEL];
@@ -55,12 +59,30 @@ static uint8_t wifiFindFreeChannel() {
 }
 
 bool CaptivePortal::exec() {
+  if (! begin())
+    return false;
+  while (process()) {
+#ifdef USE_LED
+    _led->delay(1);
+#else
+    delay(1);
+#endif
+  }
+  end();
+
+  return true;
+}
+
+bool CaptivePortal::begin(bool concurrent) {
+  if (_http)
+    return true;
+  _concurrent = concurrent;
   {
     String _ssid = ssid();
     String _pswd = password();
-    uint8_t _channel = channel();
+    uint8_t _channel = concurrent ? WiFi.channel() : channel(); // Single radio, AP has to follow STA channel
 
-    WiFi.mode(WIFI_AP);
+    WiFi.mode(concurrent ? WIFI_AP_STA : WIFI_AP);
 #ifdef USE_SERIAL
     Serial.print(F("AP \""));
     Serial.print(_ssid);
@@ -74,6 +96,8 @@ bool CaptivePortal::exec() {
 #ifdef USE_SERIAL
       Serial.println(F("FAIL!"));
 #endif
+      if (concurrent)
+        WiFi.mode(WIFI_STA);
 
       return false;
     }
@@ -86,11 +110,7 @@ bool CaptivePortal::exec() {
   _dns = new DNSServer();
   _dns->setErrorReplyCode(DNSReplyCode::NoError);
   _dns->start(53, F("*"), WiFi.softAPIP());
-#ifdef ESP32
-  _http = new WebServer(80);
-#else
-  _http = new ESP8266WebServer(80);
-#endif
+  _http = new AsyncWebServer(80);
   setupHandles();
   _http->begin();
 #ifdef USE_SERIAL
@@ -98,40 +118,44 @@ bool CaptivePortal::exec() {
   Serial.print(WiFi.softAPIP());
   Serial.println(FPSTR(ROOT_URI));
 #endif
+  _lastActivity = millis();
 
-  uint32_t start = millis();
+  return true;
+}
 
-  while (millis() - start < CP_DURATION) {
-    _dns->processNextRequest();
-    _http->handleClient();
-    if (WiFi.softAPgetStationNum()) {
-      start = millis();
+bool CaptivePortal::process() {
+  if (! _http)
+    return false;
+  _dns->processNextRequest(); // HTTP is served from TCP callbacks
+  if (_restartTime && (millis() - _restartTime >= RESTART_DELAY))
+    restart();
+  if (WiFi.softAPgetStationNum())
+    _lastActivity = millis();
 #ifdef USE_LED
-      _led->setMode(LED_CPPROCESSING);
-    } else {
-      _led->setMode(LED_CPWAITING);
-    }
-    _led->delay(1);
-#else
-    }
-    delay(1);
+  if (! _concurrent) // Led shows STA and MQTT state otherwise
+    _led->setMode(WiFi.softAPgetStationNum() ? LED_CPPROCESSING : LED_CPWAITING);
 #endif
-  }
+
+  return millis() - _lastActivity < CP_DURATION;
+}
+
+void CaptivePortal::end() {
+  if (! _http)
+    return;
 #ifdef USE_LED
-  _led->setMode(LED_OFF);
+  if (! _concurrent)
+    _led->setMode(LED_OFF);
 #endif
-  _http->close();
+  _http->end();
   delete _http;
   _http = NULL;
   _dns->stop();
   delete _dns;
   _dns = NULL;
-  WiFi.softAPdisconnect(true);
+  WiFi.softAPdisconnect(true); // Leaves STA running in concurrent mode
 #ifdef USE_SERIAL
   Serial.println(F("Access Point closed"));
 #endif
-
-  return true;
 }
 
 String CaptivePortal::ssid() const {
@@ -199,6 +223,16 @@ void CaptivePortal::cleanup() {
 #endif
 }
 
+bool CaptivePortal::storeConfig(const String &json) {
+  if (_concurrent) { // Running firmware keeps pointers to current values, store for next start only
+    DynamicJsonDocument doc(_config->jsonSize());
+
+    return (! deserializeJson(doc, json)) && _config->save(doc);
+  }
+
+  return _config->fromString(json) && _config->save();
+}
+
 void CaptivePortal::restart() {
 #ifdef USE_SERIAL
   Serial.println();
@@ -208,10 +242,19 @@ void CaptivePortal::restart() {
   ESP.restart();
 }
 
-bool CaptivePortal::isCaptivePortal() {
-  if (! _http->hostHeader().equals(WiFi.softAPIP().toString())) {
-    _http->sendHeader(F("Location"), String(F("http://")) + WiFi.softAPIP().toString(), true);
-    _http->send_P(302, TEXT_PLAIN, NULL, 0);
+bool CaptivePortal::Gate::canHandle(AsyncWebServerRequest *request) {
+  _portal->_lastActivity = millis(); // Portal stays open while served, whichever side client is on
+  // Concurrent portal is reachable from LAN, configuration with passwords and firmware update are for AP clients only
+  return _portal->_concurrent && (request->client()->localIP() != WiFi.softAPIP());
+}
+
+void CaptivePortal::Gate::handleRequest(AsyncWebServerRequest *request) {
+  request->send_P(403, FPSTR(TEXT_PLAIN), PSTR("Connect to portal access point!"));
+}
+
+bool CaptivePortal::isCaptivePortal(AsyncWebServerRequest *request) {
+  if (! request->host().equals(WiFi.softAPIP().toString())) {
+    request->redirect(String(F("http://")) + WiFi.softAPIP().toString());
 
     return true;
   }
@@ -220,52 +263,67 @@ bool CaptivePortal::isCaptivePortal() {
 }
 
 void CaptivePortal::setupHandles() {
-  _http->onNotFound([this]() { this->handleNotFound(); });
-  _http->on(FPSTR(CSS_URI), HTTP_GET, [this]() { this->handleCss(); });
-  _http->on(FPSTR(ROOT_URI), HTTP_GET, [this]() { this->handleRoot(); });
-  _http->on(FPSTR(ROOT_URI), HTTP_POST, [this]() { this->handleWriteConfig(); });
-  _http->on(FPSTR(RESTART_URI), HTTP_GET, [this]() { this->handleRestart(); });
-  _http->on(FPSTR(SPIFFS_URI), HTTP_GET, [this]() { this->handleSPIFFS(); });
-  _http->on(FPSTR(SPIFFS_URI), HTTP_POST, [this]() { this->handleFileUploaded(); }, [this]() { this->handleFileUpload(); });
-  _http->on(FPSTR(SPIFFS_URI), HTTP_DELETE, [this]() { this->handleFileDelete(); });
-  _http->on(FPSTR(FWUPDATE_URI), HTTP_GET, [this]() { this->handleFwUpdate(); });
-  _http->on(FPSTR(FWUPDATE_URI), HTTP_POST, [this]() { this->handleSketchUpdated(); }, [this]() { this->handleSketchUpdate(); });
-}
-
-void CaptivePortal::handleNotFound() {
-  if (isCaptivePortal())
+  _http->addHandler(new Gate(this)); // Server deletes handlers
+  _http->onNotFound([this](AsyncWebServerRequest *request) { this->handleNotFound(request); });
+  _http->on(String(FPSTR(CSS_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleCss(request); });
+  _http->on(String(FPSTR(ROOT_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleRoot(request); });
+  _http->on(String(FPSTR(ROOT_URI)).c_str(), HTTP_POST, [this](AsyncWebServerRequest *request) { this->handleWriteConfig(request); });
+  _http->on(String(FPSTR(RESTART_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleRestart(request); });
+  _http->on(String(FPSTR(SPIFFS_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleSPIFFS(request); });
+  _http->on(String(FPSTR(SPIFFS_URI)).c_str(), HTTP_POST, [this](AsyncWebServerRequest *request) { this->handleFileUploaded(request); },
+    [this](AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+      this->handleFileUpload(request, filename, index, data, len, final);
+    });
+  _http->on(String(FPSTR(SPIFFS_URI)).c_str(), HTTP_DELETE, [this](AsyncWebServerRequest *request) { this->handleFileDelete(request); });
+  _http->on(String(FPSTR(FWUPDATE_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleFwUpdate(request); });
+  _http->on(String(FPSTR(FWUPDATE_URI)).c_str(), HTTP_POST, [this](AsyncWebServerRequest *request) { this->handleSketchUpdated(request); },
+    [this](AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+      this->handleSketchUpdate(request, filename, index, data, len, final);
+    });
+  _http->on(String(FPSTR(API_CONFIG_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleApiGetConfig(request); });
+  _http->on(String(FPSTR(API_CONFIG_URI)).c_str(), HTTP_PUT, [this](AsyncWebServerRequest *request) { this->handleApiPutConfig(request); }, NULL,
+    [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      this->handleApiBody(request, data, len, index, total);
+    });
+  _http->on(String(FPSTR(API_FILES_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleApiFiles(request); });
+  _http->on(String(FPSTR(API_METRICS_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleApiMetrics(request); });
+  _http->on(String(FPSTR(API_UPDATE_URI)).c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) { this->handleApiUpdate(request); });
+}
+
+void CaptivePortal::handleNotFound(AsyncWebServerRequest *request) {
+  if (isCaptivePortal(request))
     return;
 
 #ifdef USE_AUTHORIZATION
-  if (! checkAuthorization())
+  if (! checkAuthorization(request))
     return;
 #endif
 
-  if (! handleFileRead(_http->uri()))
-    _http->send_P(404, TEXT_PLAIN, PSTR("Page not found!"));
+  if (! handleFileRead(request, request->url()))
+    request->send_P(404, FPSTR(TEXT_PLAIN), PSTR("Page not found!"));
 }
 
-void CaptivePortal::handleCss() {
-  if (! handleFileRead(_http->uri())) {
-    _http->send_P(200, TEXT_CSS, PSTR("body { background-color: rgb(240, 240, 240); }"));
+void CaptivePortal::handleCss(AsyncWebServerRequest *request) {
+  if (! handleFileRead(request, request->url())) {
+    request->send_P(200, FPSTR(TEXT_CSS), PSTR("body { background-color: rgb(240, 240, 240); }"));
   }
 }
 
 static const char TEXTAREA_NAME[] PROGMEM = "config";
 
-void CaptivePortal::handleRoot() {
+void CaptivePortal::handleRoot(AsyncWebServerRequest *request) {
   static const char RAW_PSTR[] PROGMEM = "raw";
 
-  if (isCaptivePortal())
+  if (isCaptivePortal(request))
     return;
 
 #ifdef USE_AUTHORIZATION
-  if (! checkAuthorization())
+  if (! checkAuthorization(request))
     return;
 #endif
 
-  if (_http->hasArg(FPSTR(RAW_PSTR))) {
-    _http->send(200, FPSTR(APPLICATION_JSON), _config->toString());
+  if (request->hasArg(FPSTR(RAW_PSTR))) {
+    request->send(200, FPSTR(APPLICATION_JSON), _config->toString());
   } else {
     String page = FPSTR(HTML_START);
     page += tag_P(PSTR("title"), F("Edit configuration"), true);
@@ -288,13 +346,13 @@ void CaptivePortal::handleRoot() {
     page += F("\"'>\n"
       "</form>\n");
     page += FPSTR(HTML_END);
-    _http->send(200, FPSTR(TEXT_HTML), page);
+    request->send(200, FPSTR(TEXT_HTML), page);
   }
 }
 
-void CaptivePortal::handleWriteConfig() {
+void CaptivePortal::handleWriteConfig(AsyncWebServerRequest *request) {
 #ifdef USE_AUTHORIZATION
-  if (! checkAuthorization())
+  if (! checkAuthorization(request))
     return;
 #endif
 
@@ -304,9 +362,9 @@ void CaptivePortal::handleWriteConfig() {
   page += F("<meta http-equiv=\"refresh\" content=\"2;URL=/\">\n");
   page += getCss();
   page += FPSTR(HEAD_END);
-  if (_http->hasArg(FPSTR(TEXTAREA_NAME))) {
-    if (_config->fromString(_http->arg(FPSTR(TEXTAREA_NAME))) && _config->save()) {
-      page += F("OK");
+  if (request->hasArg(FPSTR(TEXTAREA_NAME))) {
+    if (storeConfig(request->arg(FPSTR(TEXTAREA_NAME)))) {
+      page += _concurrent ? F("OK, restart to apply") : F("OK");
     } else {
       page += F("Error!");
       code = 500;
@@ -316,29 +374,27 @@ void CaptivePortal::handleWriteConfig() {
     code = 500;
   }
   page += FPSTR(HTML_END);
-  _http->send(code, FPSTR(TEXT_HTML), page);
+  request->send(code, FPSTR(TEXT_HTML), page);
 }
 
-void CaptivePortal::handleRestart() {
+void CaptivePortal::handleRestart(AsyncWebServerRequest *request) {
 #ifdef USE_AUTHORIZATION
-  if (! checkAuthorization())
+  if (! checkAuthorization(request))
     return;
 #endif
 
-  _http->send_P(200, TEXT_PLAIN, PSTR("Restarting..."));
-  _http->close();
-
-  restart();
+  request->send_P(200, FPSTR(TEXT_PLAIN), PSTR("Restarting..."));
+  _restartTime = millis();
 }
 
-void CaptivePortal::handleSPIFFS() {
+void CaptivePortal::handleSPIFFS(AsyncWebServerRequest *request) {
 #ifdef USE_AUTHORIZATION
-  if (! checkAuthorization())
+  if (! checkAuthorization(request))
     return;
 #endif
 
   String page = FPSTR(HTML_START);
-  page += tag_P(PSTR("title"), F("SPIFFS"), true);
+  page += tag_P(PSTR("title"), F(FILESYSTEM_NAME), true);
   page += F("<script type=\"text/javascript\">\n"
     "function getXmlHttpRequest() {\n"
     "var xmlhttp;\n"
@@ -393,56 +449,50 @@ void CaptivePortal::handleSPIFFS() {
   page += getCss();
   page += FPSTR(HEAD_END);
   page += F("<form method=\"POST\" action=\"\" enctype=\"multipart/form-data\" onsubmit=\"if (document.getElementsByName('upload')[0].files.length == 0) { alert('No file to upload!'); return false; }\">\n"
-    "<h3>SPIFFS</h3>\n"
+    "<h3>" FILESYSTEM_NAME "</h3>\n"
     "<p>\n");
 
-#ifdef ESP32
-  File dir = SPIFFS.open(FPSTR(ROOT_URI));
-  File file;
-#else
-  Dir dir = SPIFFS.openDir(FPSTR(ROOT_URI));
-#endif
-  int cnt = 0;
+  FSDir dir(String(FPSTR(ROOT_URI)).c_str());
+  uint16_t offset = request->hasArg(F("offset")) ? request->arg(F("offset")).toInt() : 0;
+  uint16_t cnt = 0;
+  bool more = false;
 
-#ifdef ESP32
-  if (dir) {
-#else
-  if (dir.isDirectory()) {
-#endif
-    page += F("<table cols=2>\n");
-#ifdef ESP32
-    while (file = dir.openNextFile()) {
-#else
-    while (dir.next()) {
-#endif
-      String fileName;
-      size_t fileSize;
-
-      ++cnt;
-#ifdef ESP32
-      fileName = file.name();
-      fileSize = file.size();
-#else
-      fileName = dir.fileName();
-      fileSize = dir.fileSize();
-#endif
-      if (fileName.startsWith(FPSTR(ROOT_URI)))
-        fileName = fileName.substring(1);
-      page += F("<tr><td><input type=\"checkbox\" name=\"file");
-      page += String(cnt);
-      page += F("\" value=\"");
-      page += fileName;
-      page += F("\" onchange=\"updateSelected()\"><a href=\"/");
-      page += fileName;
-      page += F("\" download>");
-      page += fileName;
-      page += F("</a></td><td>");
-      page += String(fileSize);
-      page += F("</td></tr>\n");
+  page += F("<table cols=2>\n");
+  while (dir.next()) {
+    if (cnt >= offset + PAGE_FILES) { // Page is limited, whole listing may not fit heap
+      more = true;
+      break;
     }
-    page += F("</table>\n");
+    if (cnt++ < offset)
+      continue;
+
+    String fileName = dir.name();
+
+    page += F("<tr><td><input type=\"checkbox\" name=\"file");
+    page += String(cnt);
+    page += F("\" value=\"");
+    page += fileName;
+    page += F("\" onchange=\"updateSelected()\"><a href=\"/");
+    page += fileName;
+    page += F("\" download>");
+    page += fileName;
+    page += F("</a></td><td>");
+    page += String(dir.size());
+    page += F("</td></tr>\n");
+  }
+  page += F("</table>\n");
+  if (offset) {
+    page += F("<a href=\"?offset=");
+    page += String(offset > PAGE_FILES ? offset - PAGE_FILES : 0);
+    page += F("\">Previous</a>\n");
+  }
+  if (more) {
+    page += F("<a href=\"?offset=");
+    page += String(offset + PAGE_FILES);
+    page += F("\">Next</a>\n");
   }
-  page += String(cnt);
+  page += F("<p>\n");
+  page += String(cnt > offset ? cnt - offset : 0);
   page += F(" file(s)\n"
     "<p>\n"
     "<input type=\"button\" name=\"delete\" value=\"Delete\" onclick=\"if (confirm('Are you sure to delete selected file(s)?') == true) deleteSelected()\" disabled>\n"
@@ -452,59 +502,136 @@ void CaptivePortal::handleSPIFFS() {
     "<input type=\"submit\" value=\"Upload\">\n"
     "</form>\n");
   page += FPSTR(HTML_END);
-  _http->send(200, FPSTR(TEXT_HTML), page);
+  request->send(200, FPSTR(TEXT_HTML), page);
 }
 
-void CaptivePortal::handleFileUploaded() {
-  _http->send_P(200, TEXT_HTML, PSTR("<META http-equiv=\"refresh\" content=\"2;URL=\">\n"
-    "Upload successful."));
+struct _upload_t { // Per request upload state, freed with request
+  PGM_P error;
+  uint32_t start;
+  uint32_t size;
+  uint16_t used;
+  char path[32]; // Filesystems limit names to 31 chars
+  char temp[12];
+  uint8_t block[CaptivePortal::UPLOAD_BLOCK];
+};
+
+void CaptivePortal::handleFileUploaded(AsyncWebServerRequest *request) {
+  _upload_t *upload = (_upload_t*)request->_tempObject;
+
+  if ((! upload) || upload->error) {
+    request->send_P(500, FPSTR(TEXT_PLAIN), upload ? upload->error : PSTR("Upload error!"));
+  } else {
+    uint32_t time = millis() - upload->start;
+    char page[128];
+
+    snprintf_P(page, sizeof(page), PSTR("<META http-equiv=\"refresh\" content=\"2;URL=\">\n"
+      "Upload successful (%u bytes in %u ms, %u KB/s)."), upload->size, time, time ? upload->size / time : 0);
+    request->send(200, FPSTR(TEXT_HTML), page);
+  }
 }
 
-void CaptivePortal::handleFileUpload() {
-  static File uploadFile;
+void CaptivePortal::handleFileUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+  _upload_t *upload = (_upload_t*)request->_tempObject;
 
-  if (_http->uri() != FPSTR(SPIFFS_URI))
+#ifdef USE_AUTHORIZATION
+  if (! authorized(request)) // Reply is sent by handleFileUploaded()
     return;
-  HTTPUpload &upload = _http->upload();
-  if (upload.status == UPLOAD_FILE_START) {
-    String filename = upload.filename;
+#endif
+  _lastActivity = millis();
+  if (! index) {
+    if (upload) // Second file in the same form, only first one is stored
+      return;
+    upload = (_upload_t*)malloc(sizeof(_upload_t));
+    if (! upload)
+      return;
+    request->_tempObject = upload;
+    upload->error = NULL;
+    upload->start = millis();
+    upload->size = 0;
+    upload->used = 0;
+    if (filename.startsWith(FPSTR(ROOT_URI)))
+      strlcpy(upload->path, filename.c_str(), sizeof(upload->path));
+    else
+      snprintf_P(upload->path, sizeof(upload->path), PSTR("/%s"), filename.c_str());
+    snprintf_P(upload->temp, sizeof(upload->temp), PSTR("/~%08x"), (uint32_t)request); // Every connection uploads to its own file
+
+    uint32_t total, used;
+
+    if (infoFS(total, used) && (request->contentLength() + UPLOAD_RESERVE > total - used)) { // Multipart body is a bit larger than file
+      upload->error = PSTR("Not enough space!");
+      return;
+    }
+
     char mode[2];
 
-    if (! filename.startsWith(FPSTR(ROOT_URI)))
-      filename = '/' + filename;
     mode[0] = 'w';
     mode[1] = '\0';
-    uploadFile = SPIFFS.open(filename, mode);
-  } else if (upload.status == UPLOAD_FILE_WRITE) {
-    if (uploadFile)
-      uploadFile.write(upload.buf, upload.currentSize);
-  } else if (upload.status == UPLOAD_FILE_END) {
-    if (uploadFile)
-      uploadFile.close();
+    request->_tempFile = FILESYSTEM.open(upload->temp, mode);
+    if (! request->_tempFile) {
+      upload->error = PSTR("File create error!");
+      return;
+    }
+    request->onDisconnect([request, upload]() { // Broken upload leaves no partial file
+      if (request->_tempFile)
+        request->_tempFile.close();
+      FILESYSTEM.remove(upload->temp);
+    });
+  }
+  if ((! upload) || upload->error)
+    return;
+  while (len) { // Filesystem gets whole flash pages instead of TCP segment sized pieces
+    uint16_t part = len < UPLOAD_BLOCK - upload->used ? len : UPLOAD_BLOCK - upload->used;
+
+    memcpy(&upload->block[upload->used], data, part);
+    upload->used += part;
+    data += part;
+    len -= part;
+    if (upload->used == UPLOAD_BLOCK) {
+      if (request->_tempFile.write(upload->block, UPLOAD_BLOCK) != UPLOAD_BLOCK) {
+        upload->error = PSTR("File write error!");
+        return;
+      }
+      upload->size += UPLOAD_BLOCK;
+      upload->used = 0;
+    }
+  }
+  if (final) {
+    if (upload->used && (request->_tempFile.write(upload->block, upload->used) != upload->used)) {
+      upload->error = PSTR("File write error!");
+      return;
+    }
+    upload->size += upload->used;
+    upload->used = 0;
+    request->_tempFile.close();
+#ifndef USE_LITTLEFS
+    FILESYSTEM.remove(upload->path); // SPIFFS can not rename over existing file, LittleFS replaces it atomically
+#endif
+    if (! FILESYSTEM.rename(upload->temp, upload->path))
+      upload->error = PSTR("File rename error!");
   }
 }
 
-void CaptivePortal::handleFileDelete() {
+void CaptivePortal::handleFileDelete(AsyncWebServerRequest *request) {
 #ifdef USE_AUTHORIZATION
-  if (! checkAuthorization())
+  if (! checkAuthorization(request))
     return;
 #endif
 
-  if (! _http->args())
-    return _http->send_P(500, TEXT_PLAIN, PSTR("BAD ARGS"));
+  if (! request->args())
+    return request->send_P(500, FPSTR(TEXT_PLAIN), PSTR("BAD ARGS"));
 
-  String path = _http->arg(0);
+  String path = request->arg(0);
   if (path == FPSTR(ROOT_URI))
-    return _http->send_P(500, TEXT_PLAIN, PSTR("BAD PATH"));
-  if (! SPIFFS.exists(path))
-    return _http->send_P(404, TEXT_PLAIN, PSTR("File not found!"));
-  SPIFFS.remove(path);
-  _http->send_P(200, TEXT_PLAIN, PSTR("OK"));
+    return request->send_P(500, FPSTR(TEXT_PLAIN), PSTR("BAD PATH"));
+  if (! FILESYSTEM.exists(path))
+    return request->send_P(404, FPSTR(TEXT_PLAIN), PSTR("File not found!"));
+  FILESYSTEM.remove(path);
+  request->send_P(200, FPSTR(TEXT_PLAIN), PSTR("OK"));
 }
 
-void CaptivePortal::handleFwUpdate() {
+void CaptivePortal::handleFwUpdate(AsyncWebServerRequest *request) {
 #ifdef USE_AUTHORIZATION
-  if (! checkAuthorization())
+  if (! checkAuthorization(request))
     return;
 #endif
 
@@ -512,88 +639,321 @@ void CaptivePortal::handleFwUpdate() {
   page += tag_P(PSTR("title"), F("Sketch Update"), true);
   page += getCss();
   page += FPSTR(HEAD_END);
-  page += F("<form method=\"POST\" action=\"\" enctype=\"multipart/form-data\" onsubmit=\"if (document.getElementsByName('update')[0].files.length == 0) { alert('No file to update!'); return false; }\">\n"
-    "Select compiled sketch to upload:<br/>\n"
+  page += F("<form method=\"POST\" action=\"\" enctype=\"multipart/form-data\" onsubmit=\"if (document.getElementsByName('upload')[0].files.length == 0) { alert('No file to update!'); return false; }\">\n"
+    "MD5 of file (optional):<br/>\n"
+    "<input type=\"text\" name=\"md5\" size=32 maxlength=32><br/>\n" // Before file, multipart fields arrive in order
+    "Select compiled sketch (.bin or .bin.gz) to upload:<br/>\n"
     "<input type=\"file\" name=\"upload\">\n"
     "<input type=\"submit\" value=\"Update\">\n"
     "</form>\n");
   page += FPSTR(HTML_END);
-  _http->send(200, FPSTR(TEXT_HTML), page);
+  request->send(200, FPSTR(TEXT_HTML), page);
 }
 
-void CaptivePortal::handleSketchUpdated() {
-  _http->send_P(200, TEXT_HTML, Update.hasError() ? PSTR("Update failed!") : PSTR("<META http-equiv=\"refresh\" content=\"15;URL=\">\nUpdate successful! Rebooting..."));
-  if (! Update.hasError()) {
-    _http->close();
-    restart();
+void CaptivePortal::handleSketchUpdated(AsyncWebServerRequest *request) {
+  if (_otaRequest && (request != _otaRequest)) { // State belongs to other upload
+    request->send_P(409, FPSTR(TEXT_HTML), PSTR("Other update in progress!"));
+
+    return;
   }
+
+  bool ok = (request == _otaRequest) && (_otaState == OTA_DONE);
+
+  request->send_P(ok ? 200 : 500, FPSTR(TEXT_HTML), ok ? PSTR("<META http-equiv=\"refresh\" content=\"15;URL=\">\nUpdate successful! Rebooting...") : PSTR("Update failed!"));
+  if (ok)
+    _restartTime = millis();
 }
 
-void CaptivePortal::handleSketchUpdate() {
-  if (_http->uri() != FPSTR(FWUPDATE_URI))
-    return;
+bool CaptivePortal::beginUpdate(AsyncWebServerRequest *request, const uint8_t *data, size_t len) {
+  const uint16_t MULTIPART_OVERHEAD = 1024; // Boundaries, headers and md5 field around image
+
+  uint32_t maxSize = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+  size_t size = request->contentLength();
+
+  _otaError = NULL;
+  _otaCompressed = (len >= 2) && (data[0] == 0x1F) && (data[1] == 0x8B);
+#if defined(ESP32) || (! defined(ARDUINO_ESP8266_MAJOR))
+  if (_otaCompressed) { // Bootloader of this core can not unpack image
+    _otaError = PSTR("compressed image is not supported");
+
+    return false;
+  }
+#endif
+  if (size > maxSize + MULTIPART_OVERHEAD) { // Fail before slow upload, not at its end
+    _otaError = PSTR("not enough space");
 
-  HTTPUpload &upload = _http->upload();
-  if (upload.status == UPLOAD_FILE_START) {
+    return false;
+  }
+  if ((! size) || (size > maxSize))
+    size = maxSize; // Reserved size is an upper bound, Update.end(true) trims it to written one
+  if (Update.isRunning()) { // MQTT update in progress
+    _otaError = PSTR("update in progress");
+
+    return false;
+  }
+  if (! Update.begin(size))
+    return false;
+  if (request->hasArg(FPSTR(MD5_PARAM)) && request->arg(FPSTR(MD5_PARAM)).length()) { // Checked by Update.end() before commit
+    if (! Update.setMD5(request->arg(FPSTR(MD5_PARAM)).c_str())) {
+      _otaError = PSTR("wrong MD5");
+      Update.end();
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void CaptivePortal::handleSketchUpdate(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+#ifdef USE_AUTHORIZATION
+  if (! authorized(request)) // Reply is sent by handleSketchUpdated()
+    return;
+#endif
+  _lastActivity = millis();
+  if (! index) {
+    if (_otaRequest) // Another upload is running, its state is left alone
+      return;
+    _otaRequest = request;
+    request->onDisconnect([this]() {
+      if ((_otaState == OTA_RUNNING) && Update.isRunning()) { // Truncated upload never gets final chunk
+        Update.end();
+        _otaState = OTA_FAILED;
+        _otaError = PSTR("upload truncated");
+      }
+      _otaRequest = NULL;
+    });
 //    cleanup();
 #ifndef ESP32
-    WiFiUDP::stopAll();
+    if (! _concurrent) // Running firmware keeps DNS and output UDP sockets
+      WiFiUDP::stopAll();
+    Update.runAsync(true); // Must not yield in TCP callback
 #endif
 #ifdef USE_SERIAL
     Serial.print(F("Update sketch from file \""));
-    Serial.print(upload.filename);
+    Serial.print(filename);
     Serial.print('"');
 #endif
-    if (! Update.begin((ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000)) { // start with max available size
+    _otaStart = millis();
+    _otaTime = 0;
+    if (beginUpdate(request, data, len)) {
+      _otaState = OTA_RUNNING;
+    } else {
+      _otaState = OTA_FAILED;
 #ifdef USE_SERIAL
       Serial.println();
-      Update.printError(Serial);
+      if (_otaError)
+        Serial.println(FPSTR(_otaError));
+      else
+        Update.printError(Serial);
 #endif
     }
-  } else if (upload.status == UPLOAD_FILE_WRITE) {
+  }
+  if ((request != _otaRequest) || (_otaState != OTA_RUNNING))
+    return;
+  if (len) {
 #ifdef USE_SERIAL
     Serial.print('.');
 #endif
-    if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
+    if (Update.write(data, len) != len) {
+      _otaState = OTA_FAILED;
 #ifdef USE_SERIAL
       Serial.println();
       Update.printError(Serial);
 #endif
+      Update.end();
+
+      return;
     }
-  } else if (upload.status == UPLOAD_FILE_END) {
+  }
+  if (final) {
+    _otaTime = millis() - _otaStart;
 #ifdef USE_SERIAL
     Serial.println();
 #endif
     if (Update.end(true)) { // true to set the size to the current progress
+      _otaState = OTA_DONE;
 #ifdef USE_SERIAL
       Serial.print(F("Updated "));
-      Serial.print(upload.totalSize);
-      Serial.println(F(" byte(s) successful"));
+      Serial.print(index + len);
+      Serial.print(F(" byte(s)"));
+      if (_otaCompressed)
+        Serial.print(F(" compressed"));
+      Serial.print(F(" successful in "));
+      Serial.print(_otaTime);
+      Serial.println(F(" ms"));
 #endif
     } else {
+      _otaState = OTA_FAILED;
 #ifdef USE_SERIAL
       Update.printError(Serial);
 #endif
     }
-  } else if (upload.status == UPLOAD_FILE_ABORTED) {
-    Update.end();
-#ifdef USE_SERIAL
-    Serial.println();
-    Serial.println(F("Update was aborted!"));
+  }
+}
+
+void CaptivePortal::handleApiUpdate(AsyncWebServerRequest *request) {
+  static const char STATES[][8] PROGMEM = { "idle", "running", "done", "failed" };
+
+#ifdef USE_AUTHORIZATION
+  if (! checkAuthorization(request))
+    return;
 #endif
+
+  StaticJsonDocument<256> doc;
+
+  doc[F("state")] = FPSTR(STATES[_otaState]);
+  if (_otaState != OTA_IDLE) {
+    doc[F("compressed")] = _otaCompressed;
+    doc[F("ms")] = _otaState == OTA_RUNNING ? millis() - _otaStart : _otaTime;
+  }
+  if (_otaState == OTA_RUNNING) {
+    doc[F("progress")] = Update.progress();
+    doc[F("size")] = Update.size(); // Upper bound until the last chunk
+  } else if (_otaState == OTA_FAILED) {
+    if (_otaError)
+      doc[F("error")] = FPSTR(_otaError);
+    else
+      doc[F("error")] = Update.getError();
   }
-  yield();
+  sendJson(request, 200, doc);
+}
+
+void CaptivePortal::handleApiGetConfig(AsyncWebServerRequest *request) {
+#ifdef USE_AUTHORIZATION
+  if (! checkAuthorization(request))
+    return;
+#endif
+
+  request->send(200, FPSTR(APPLICATION_JSON), _config->toString());
 }
 
+void CaptivePortal::handleApiBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
 #ifdef USE_AUTHORIZATION
-bool CaptivePortal::checkAuthorization() {
+  if (! authorized(request)) // Reply is sent by handleApiPutConfig()
+    return;
+#endif
+  _lastActivity = millis();
+  if (total >= _config->jsonSize())
+    return;
+  if (! index)
+    request->_tempObject = malloc(total + 1); // Freed with request
+  if (request->_tempObject) {
+    memcpy((uint8_t*)request->_tempObject + index, data, len);
+    if (index + len == total)
+      ((char*)request->_tempObject)[total] = '\0';
+  }
+}
+
+void CaptivePortal::handleApiPutConfig(AsyncWebServerRequest *request) {
+#ifdef USE_AUTHORIZATION
+  if (! checkAuthorization(request))
+    return;
+#endif
+
+  if (! request->_tempObject)
+    return request->send_P(400, FPSTR(APPLICATION_JSON), PSTR("{\"result\":\"error\"}"));
+
+  DynamicJsonDocument doc(_config->jsonSize());
+  StaticJsonDocument<512> reply;
+  JsonArray changed = reply.createNestedArray(F("changed"));
+  JsonArray rejected = reply.createNestedArray(F("rejected"));
+  const char *json = (const char*)request->_tempObject;
+  bool result = _config->merge(json, strlen(json), doc, changed, rejected);
+
+  if (! result)
+    changed.clear(); // Patch is applied as a whole or not at all
+  if (result && changed.size()) {
+    if (! _concurrent) // Running firmware keeps pointers to current values otherwise
+      _config->apply(doc);
+    result = _config->save(doc);
+  }
+  reply[F("result")] = result ? F("ok") : F("error");
+  reply[F("restart")] = result && _concurrent && changed.size();
+  sendJson(request, result ? 200 : 400, reply);
+}
+
+void CaptivePortal::handleApiFiles(AsyncWebServerRequest *request) {
+#ifdef USE_AUTHORIZATION
+  if (! checkAuthorization(request))
+    return;
+#endif
+
+  const uint16_t MAX_LIMIT = 100;
+
+  uint32_t start = micros();
+  uint16_t offset = request->hasArg(F("offset")) ? request->arg(F("offset")).toInt() : 0;
+  uint16_t limit = request->hasArg(F("limit")) ? request->arg(F("limit")).toInt() : PAGE_FILES;
+  uint16_t cnt = 0;
+  bool more = false;
+  uint32_t total, used;
+  FSDir dir(String(FPSTR(ROOT_URI)).c_str());
+  AsyncResponseStream *response = request->beginResponseStream(FPSTR(APPLICATION_JSON));
+
+  if ((! limit) || (limit > MAX_LIMIT))
+    limit = MAX_LIMIT;
+  response->print(F("{\"fs\":\"" FILESYSTEM_NAME "\""));
+  if (infoFS(total, used))
+    response->printf_P(PSTR(",\"total\":%u,\"used\":%u"), total, used);
+  response->printf_P(PSTR(",\"offset\":%u,\"files\":["), offset);
+  while (dir.next()) {
+    if (cnt >= offset + limit) {
+      more = true;
+      break;
+    }
+    if (cnt++ < offset) // Backends can not seek in directory, skipped entries are cheap, rendered are not
+      continue;
+
+    StaticJsonDocument<96> item; // Streamed one by one, page size does not cost heap
+
+    item[F("name")] = dir.name();
+    item[F("size")] = dir.size();
+    if (cnt > offset + 1)
+      response->print(',');
+    serializeJson(item, *response);
+  }
+  response->printf_P(PSTR("],\"more\":%S,\"us\":%u}"), more ? PSTR("true") : PSTR("false"), micros() - start);
+  request->send(response);
+}
+
+void CaptivePortal::handleApiMetrics(AsyncWebServerRequest *request) {
+#ifdef USE_AUTHORIZATION
+  if (! checkAuthorization(request))
+    return;
+#endif
+
+  DynamicJsonDocument doc(BaseConfig::JSON_BUF_SIZE);
+
+  doc[F("uptime")] = millis() / 1000;
+  doc[F("heap")] = ESP.getFreeHeap();
+  doc[F("ap_clients")] = WiFi.softAPgetStationNum();
+  if (_metrics)
+    _metrics(doc);
+  sendJson(request, 200, doc);
+}
+
+void CaptivePortal::sendJson(AsyncWebServerRequest *request, uint16_t code, const JsonDocument &doc) {
+  AsyncResponseStream *response = request->beginResponseStream(FPSTR(APPLICATION_JSON), measureJson(doc));
+
+  serializeJson(doc, *response); // Compact, no pretty printing
+  response->setCode(code);
+  request->send(response);
+}
+
+#ifdef USE_AUTHORIZATION
+bool CaptivePortal::authorized(AsyncWebServerRequest *request) {
   char user[sizeof(AUTH_USER)];
   char pswd[sizeof(AUTH_PSWD)];
 
   strcpy_P(user, PSTR(AUTH_USER));
   strcpy_P(pswd, PSTR(AUTH_PSWD));
-  if (! _http->authenticate(user, pswd)) {
-    _http->requestAuthentication();
+
+  return request->authenticate(user, pswd);
+}
+
+bool CaptivePortal::checkAuthorization(AsyncWebServerRequest *request) {
+  if (! authorized(request)) {
+    request->requestAuthentication();
 
     return false;
   }
@@ -602,8 +962,8 @@ bool CaptivePortal::checkAuthorization() {
 }
 #endif
 
-String CaptivePortal::getContentType(const String &fileName) {
-  if (_http->hasArg(F("download")))
+String CaptivePortal::getContentType(AsyncWebServerRequest *request, const String &fileName) {
+  if (request->hasArg(F("download")))
     return String(F("application/octet-stream"));
   else if (fileName.endsWith(F(".htm")) || fileName.endsWith(F(".html")))
     return String(FPSTR(TEXT_HTML));
@@ -631,24 +991,16 @@ String CaptivePortal::getContentType(const String &fileName) {
   return String(FPSTR(TEXT_PLAIN));
 }
 
-bool CaptivePortal::handleFileRead(const String &path) {
+bool CaptivePortal::handleFileRead(AsyncWebServerRequest *request, const String &path) {
   String fileName = path;
 
   if (fileName.endsWith(FPSTR(ROOT_URI)))
     fileName += FPSTR(INDEX_HTML);
-  String contentType = getContentType(fileName);
-  if (SPIFFS.exists(fileName)) {
-    char mode[2];
-
-    mode[0] = 'r';
-    mode[1] = '\0';
-    File file = SPIFFS.open(fileName, mode);
-    if (file) {
-      _http->streamFile(file, contentType);
-      file.close();
+  String contentType = getContentType(request, fileName);
+  if (FILESYSTEM.exists(fileName)) { // Response streams the file by chunks from TCP callbacks
+    request->send(FILESYSTEM, fileName, contentType);
 
-      return true;
-    }
+    return true;
   }
 
   return false;
@@ -0,0 +1,64 @@
+#include <time.h>
+#include <sys/time.h>
+#include <coredecls.h>
+#include "Clock.h"
+
+Clock sysClock;
+
+static void onTimeSet() {
+  sysClock.sync();
+}
+
+void Clock::begin(const char *server) {
+  settimeofday_cb(onTimeSet);
+  configTime(0, 0, server); // UTC, payloads carry epoch time
+}
+
+void Clock::sync() {
+  struct timeval tv;
+  uint64_t ms = monotonic() / 1000;
+  int64_t target;
+
+  gettimeofday(&tv, NULL);
+  target = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - ms;
+  if (_syncs) {
+    int64_t current = offset(ms);
+    int64_t error = target - current;
+
+    _drift = error;
+    if ((error > -(int64_t)STEP_LIMIT) && (error < (int64_t)STEP_LIMIT)) { // Slew, wall clock never goes back
+      _offset = current;
+      _error = error;
+      _slewstart = ms;
+    } else {
+      _offset = target;
+      _error = 0;
+    }
+  } else {
+    _offset = target;
+    _error = 0;
+  }
+  ++_syncs;
+}
+
+uint64_t Clock::now() const {
+  return toWall(monotonic());
+}
+
+uint64_t Clock::toWall(uint64_t mono) const {
+  uint64_t ms = mono / 1000;
+
+  if (! _syncs)
+    return ms;
+
+  return ms + offset(ms);
+}
+
+int64_t Clock::offset(uint64_t ms) const {
+  uint64_t elapsed = ms - _slewstart;
+
+  if ((! _error) || (elapsed >= SLEW_PERIOD))
+    return _offset + _error;
+
+  return _offset + (int64_t)_error * (int64_t)elapsed / SLEW_PERIOD;
+}
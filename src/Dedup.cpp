@@ -0,0 +1,82 @@
+#include <Arduino.h>
+#include "Dedup.h"
+
+void Dedup::clear() {
+  memset(_items, 0, sizeof(_items));
+}
+
+bool Dedup::isDuplicate(const char *code, uint8_t len, const char *topic) {
+  if ((_mode == DEDUP_OFF) || (! _window))
+    return false;
+
+  uint32_t now = millis();
+  uint8_t victim;
+  int8_t index = probe(hash(code, len, _mode == DEDUP_TOPIC ? topic : NULL), now, victim);
+
+  if (index < 0)
+    return false;
+  _items[index].time = now; // Sliding window while scanner keeps repeating
+  ++_suppressed;
+
+  return true;
+}
+
+void Dedup::remember(const char *code, uint8_t len, const char *topic) {
+  if ((_mode == DEDUP_OFF) || (! _window))
+    return;
+
+  uint32_t h = hash(code, len, _mode == DEDUP_TOPIC ? topic : NULL);
+  uint32_t now = millis();
+  uint8_t victim;
+  int8_t index = probe(h, now, victim);
+
+  if (index < 0)
+    index = victim;
+  _items[index].hash = h;
+  _items[index].time = now;
+}
+
+int8_t Dedup::probe(uint32_t h, uint32_t now, uint8_t &victim) const {
+  uint32_t oldest = 0;
+
+  victim = h & (SIZE - 1);
+  for (uint8_t i = 0; i < MAX_PROBES; ++i) {
+    uint8_t index = (h + i) & (SIZE - 1);
+    uint32_t age = now - _items[index].time;
+
+    if (! _items[index].hash) { // Free slot, end of chain
+      if (oldest < _window)
+        victim = index;
+      break;
+    }
+    if ((age < _window) && (_items[index].hash == h))
+      return index;
+    if (age > oldest) { // Expired or least recent slot will be reused
+      victim = index;
+      oldest = age;
+    }
+  }
+
+  return -1;
+}
+
+uint32_t Dedup::hash(const char *code, uint8_t len, const char *topic) {
+  uint32_t result = 2166136261UL; // FNV-1a
+
+  while (len--) {
+    result ^= (uint8_t)*code++;
+    result *= 16777619UL;
+  }
+  if (topic) {
+    result ^= 0xFF; // Separator
+    result *= 16777619UL;
+    while (*topic) {
+      result ^= (uint8_t)*topic++;
+      result *= 16777619UL;
+    }
+  }
+  if (! result) // 0 marks free slot
+    result = 1;
+
+  return result;
+}
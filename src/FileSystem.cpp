@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include "FileSystem.h"
+#ifdef FS_BENCHMARK
+#include "Logger.h"
+#endif
+
+FSDir::FSDir(const char *path) {
+#ifdef ESP32
+  _dir = FILESYSTEM.open(path);
+#else
+  _dir = FILESYSTEM.openDir(path);
+#endif
+}
+
+bool FSDir::next() {
+#ifdef ESP32
+  if (! _dir)
+    return false;
+  while (_file = _dir.openNextFile()) {
+    if (! _file.isDirectory())
+      return true;
+  }
+#else
+  while (_dir.next()) {
+    if (_dir.isFile())
+      return true;
+  }
+#endif
+
+  return false;
+}
+
+String FSDir::name() const {
+#ifdef ESP32
+  String result = _file.name();
+#else
+  String result = _dir.fileName();
+#endif
+
+  if (result.startsWith(F("/"))) // SPIFFS keeps full path
+    result.remove(0, 1);
+
+  return result;
+}
+
+size_t FSDir::size() const {
+#ifdef ESP32
+  return _file.size();
+#else
+  return _dir.fileSize();
+#endif
+}
+
+bool initFS() {
+#ifdef ESP32
+  return FILESYSTEM.begin(true);
+#else
+  if (! FILESYSTEM.begin()) {
+    if ((! FILESYSTEM.format()) || (! FILESYSTEM.begin())) {
+      return false;
+    }
+  }
+  return true;
+#endif
+}
+
+bool infoFS(uint32_t &total, uint32_t &used) {
+#ifdef ESP32
+  total = FILESYSTEM.totalBytes();
+  used = FILESYSTEM.usedBytes();
+
+  return true;
+#else
+  FSInfo info;
+
+  if (! FILESYSTEM.info(info))
+    return false;
+  total = info.totalBytes;
+  used = info.usedBytes;
+
+  return true;
+#endif
+}
+
+#ifdef FS_BENCHMARK
+void benchmarkFS(uint16_t files) {
+  char path[16];
+  char mode[2];
+  uint32_t start, created, opened, listed;
+  uint16_t found = 0;
+
+  if (! files)
+    return;
+  mode[1] = '\0';
+  mode[0] = 'w';
+  start = micros();
+  for (uint16_t i = 0; i < files; ++i) {
+    snprintf_P(path, sizeof(path), PSTR("/b%05u"), i);
+
+    File file = FILESYSTEM.open(path, mode);
+
+    if (file) {
+      file.write((const uint8_t*)path, sizeof(path));
+      file.close();
+    }
+    yield();
+  }
+  created = micros() - start;
+
+  mode[0] = 'r';
+  start = micros();
+  for (uint16_t i = 0; i < files; ++i) {
+    snprintf_P(path, sizeof(path), PSTR("/b%05u"), (uint16_t)((i * 7919UL) % files)); // Scattered order
+
+    File file = FILESYSTEM.open(path, mode);
+
+    if (file)
+      file.close();
+    yield();
+  }
+  opened = micros() - start;
+
+  start = micros();
+  {
+    FSDir dir("/");
+
+    while (dir.next()) {
+      ++found;
+      yield();
+    }
+  }
+  listed = micros() - start;
+
+  for (uint16_t i = 0; i < files; ++i) {
+    snprintf_P(path, sizeof(path), PSTR("/b%05u"), i);
+    FILESYSTEM.remove(path);
+    yield();
+  }
+  LOG_I(FILESYSTEM_NAME " with %u file(s): create %u us, open %u us, list %u us per file", found,
+    created / files, opened / files, found ? listed / found : 0);
+}
+#endif
@@ -0,0 +1,190 @@
+#include "GM65.h"
+#include "Symbology.h"
+
+struct __packed _gm65symbology_t {
+  symbology_t symbology;
+  uint16_t zone; // Bit 0 - enable
+};
+
+static const _gm65symbology_t GM65_SYMBOLOGIES[] PROGMEM = {
+  { SYM_EAN13, 0x002E },
+  { SYM_EAN8, 0x002F },
+  { SYM_UPCA, 0x0030 },
+  { SYM_UPCE, 0x0031 }, // UPC-E0
+  { SYM_UPCE, 0x0032 }, // UPC-E1
+  { SYM_CODE128, 0x0033 },
+  { SYM_CODE39, 0x0036 },
+  { SYM_CODABAR, 0x003C },
+  { SYM_QR, 0x003F },
+  { SYM_ITF, 0x0040 },
+  { SYM_DATAMATRIX, 0x0054 },
+  { SYM_PDF417, 0x0055 },
+};
+
+bool GM65::begin(uint32_t baud) {
+  static const uint32_t FACTORY_BAUD = 9600;
+
+  if (! baud)
+    return false;
+  _baud = baud;
+  _serial.updateBaudRate(baud);
+  if (probe()) // Already configured
+    return true;
+  if (baud != FACTORY_BAUD) {
+    _baud = FACTORY_BAUD;
+    _serial.updateBaudRate(FACTORY_BAUD);
+    if (! probe())
+      return false;
+
+    uint16_t divider = 3000000UL / baud;
+    uint8_t data[2];
+
+    data[0] = divider & 0xFF;
+    data[1] = divider >> 8;
+    if (! writeZone(ZONE_BAUD, data, sizeof(data)))
+      return false;
+    _serial.flush();
+    _baud = baud;
+    _serial.updateBaudRate(baud);
+    delay(50); // Scanner reinitializes its UART
+
+    return probe();
+  }
+
+  return false;
+}
+
+bool GM65::setMode(gm65mode_t mode) {
+  if (mode == GM65_KEEP)
+    return true;
+
+  return modifyZone(ZONE_SETTINGS, 0x03, mode);
+}
+
+bool GM65::setTail(gm65tail_t tail) {
+  if (tail == GM65_TAIL_KEEP)
+    return true;
+
+  return modifyZone(ZONE_TAIL, 0x61, (tail << 5) | ((tail != GM65_TAIL_NONE) ? 0x01 : 0x00)); // Type 11 and tail disallowed for none
+}
+
+bool GM65::setCodeId(bool enable) {
+  return modifyZone(ZONE_TAIL, 0x04, enable ? 0x04 : 0x00);
+}
+
+bool GM65::enableSymbologies(uint16_t mask) {
+  if (! mask)
+    return true;
+  for (uint8_t i = 0; i < sizeof(GM65_SYMBOLOGIES) / sizeof(GM65_SYMBOLOGIES[0]); ++i) {
+    _gm65symbology_t s;
+
+    memcpy_P(&s, &GM65_SYMBOLOGIES[i], sizeof(s));
+    if (! modifyZone(s.zone, 0x01, (mask >> s.symbology) & 0x01))
+      return false;
+  }
+
+  return true;
+}
+
+bool GM65::save() {
+  uint8_t data = 0x00;
+
+  return command(CMD_SAVE, 0x0000, &data, sizeof(data));
+}
+
+bool GM65::readZone(uint16_t address, uint8_t *data, uint8_t len) {
+  return command(CMD_READ, address, &len, sizeof(len), data, len);
+}
+
+bool GM65::writeZone(uint16_t address, const uint8_t *data, uint8_t len) {
+  return command(CMD_WRITE, address, data, len);
+}
+
+uint16_t GM65::crc(const uint8_t *data, uint8_t len) {
+  uint16_t result = 0; // CRC-CCITT (XModem)
+
+  while (len--) {
+    result ^= (uint16_t)*data++ << 8;
+    for (uint8_t i = 0; i < 8; ++i) {
+      if (result & 0x8000)
+        result = (result << 1) ^ 0x1021;
+      else
+        result <<= 1;
+    }
+  }
+
+  return result;
+}
+
+bool GM65::command(uint8_t type, uint16_t address, const uint8_t *data, uint8_t len, uint8_t *reply, uint8_t replylen) {
+  uint8_t frame[2 + 4 + 8 + 2];
+
+  if (len > 8)
+    return false;
+  frame[0] = 0x7E;
+  frame[1] = 0x00;
+  frame[2] = type;
+  frame[3] = len;
+  frame[4] = address >> 8;
+  frame[5] = address & 0xFF;
+  memcpy(&frame[6], data, len);
+
+  uint16_t c = crc(&frame[2], 4 + len);
+
+  frame[6 + len] = c >> 8;
+  frame[7 + len] = c & 0xFF;
+  while (_serial.available()) // Drop pending barcode data
+    _serial.read();
+  _serial.write(frame, 8 + len);
+
+  // Reply: 02 00 <status> <len> <data...> <crc16>
+  uint8_t buf[4 + 8 + 2];
+  uint8_t pos = 0;
+  uint32_t start = millis();
+
+  while (millis() - start < TIMEOUT) {
+    if (! _serial.available()) {
+      yield();
+      continue;
+    }
+    buf[pos] = _serial.read();
+    if (((pos == 0) && (buf[0] != 0x02)) || ((pos == 1) && (buf[1] != 0x00))) {
+      pos = 0;
+      continue;
+    }
+    if ((pos == 3) && (buf[3] > 8))
+      return false;
+    if ((++pos >= 4) && (pos == 4 + buf[3] + 2)) {
+      c = crc(&buf[2], 2 + buf[3]);
+      if ((buf[2] != 0x00) || (buf[pos - 2] != (c >> 8)) || (buf[pos - 1] != (c & 0xFF)))
+        return false;
+      if (reply) {
+        if (buf[3] < replylen)
+          return false;
+        memcpy(reply, &buf[4], replylen);
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool GM65::modifyZone(uint16_t address, uint8_t mask, uint8_t value) {
+  uint8_t data;
+
+  if (! readZone(address, &data, sizeof(data)))
+    return false;
+  if ((data & mask) == (value & mask))
+    return true;
+  data = (data & ~mask) | (value & mask);
+
+  return writeZone(address, &data, sizeof(data));
+}
+
+bool GM65::probe() {
+  uint8_t data;
+
+  return readZone(ZONE_SETTINGS, &data, sizeof(data));
+}
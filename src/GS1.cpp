@@ -0,0 +1,143 @@
+#include <Arduino.h>
+#include "GS1.h"
+#include "Symbology.h"
+
+struct __packed _gs1ai_t {
+  char prefix[5]; // AI digits to match, shorter than ailen for AI families (310n, 91..99)
+  char last; // Highest digit following prefix of AI family
+  uint8_t ailen : 3;
+  bool fixed : 1;
+  bool numeric : 1; // Data digits only
+  uint8_t datalen; // Fixed or maximal data length
+  PGM_P name; // NULL to use AI digits as key
+};
+
+static const char AI_SSCC[] PROGMEM = "sscc";
+static const char AI_GTIN[] PROGMEM = "gtin";
+static const char AI_CONTENT[] PROGMEM = "content";
+static const char AI_BATCH[] PROGMEM = "batch";
+static const char AI_PROD_DATE[] PROGMEM = "prod_date";
+static const char AI_DUE_DATE[] PROGMEM = "due_date";
+static const char AI_PACK_DATE[] PROGMEM = "pack_date";
+static const char AI_BEST_BEFORE[] PROGMEM = "best_before";
+static const char AI_SELL_BY[] PROGMEM = "sell_by";
+static const char AI_EXPIRY[] PROGMEM = "expiry";
+static const char AI_VARIANT[] PROGMEM = "variant";
+static const char AI_SERIAL[] PROGMEM = "serial";
+static const char AI_ADDITIONAL_ID[] PROGMEM = "additional_id";
+static const char AI_CUSTOMER_PART[] PROGMEM = "customer_part";
+static const char AI_COUNT[] PROGMEM = "count";
+static const char AI_ORDER[] PROGMEM = "order";
+static const char AI_SHIP_TO[] PROGMEM = "ship_to";
+static const char AI_SHIP_TO_POST[] PROGMEM = "ship_to_post";
+
+static const _gs1ai_t GS1_AIS[] PROGMEM = {
+  { "00", '9', 2, true, true, 18, AI_SSCC },
+  { "01", '9', 2, true, true, 14, AI_GTIN },
+  { "02", '9', 2, true, true, 14, AI_CONTENT },
+  { "10", '9', 2, false, false, 20, AI_BATCH },
+  { "11", '9', 2, true, true, 6, AI_PROD_DATE },
+  { "12", '9', 2, true, true, 6, AI_DUE_DATE },
+  { "13", '9', 2, true, true, 6, AI_PACK_DATE },
+  { "15", '9', 2, true, true, 6, AI_BEST_BEFORE },
+  { "16", '9', 2, true, true, 6, AI_SELL_BY },
+  { "17", '9', 2, true, true, 6, AI_EXPIRY },
+  { "20", '9', 2, true, true, 2, AI_VARIANT },
+  { "21", '9', 2, false, false, 20, AI_SERIAL },
+  { "22", '9', 2, false, false, 29, NULL },
+  { "240", '9', 3, false, false, 30, AI_ADDITIONAL_ID },
+  { "241", '9', 3, false, false, 30, AI_CUSTOMER_PART },
+  { "250", '9', 3, false, false, 30, NULL },
+  { "30", '9', 2, false, true, 8, NULL },
+  { "31", '6', 4, true, true, 6, NULL }, // Trade measures 310n..316n
+  { "32", '9', 4, true, true, 6, NULL },
+  { "33", '7', 4, true, true, 6, NULL },
+  { "34", '9', 4, true, true, 6, NULL },
+  { "35", '7', 4, true, true, 6, NULL },
+  { "36", '9', 4, true, true, 6, NULL },
+  { "37", '9', 2, false, true, 8, AI_COUNT },
+  { "400", '9', 3, false, false, 30, AI_ORDER },
+  { "401", '9', 3, false, false, 30, NULL },
+  { "402", '9', 3, true, true, 17, NULL },
+  { "410", '9', 3, true, true, 13, AI_SHIP_TO },
+  { "41", '7', 3, true, true, 13, NULL }, // 411..417 GLNs
+  { "420", '9', 3, false, false, 20, AI_SHIP_TO_POST },
+  { "421", '9', 3, false, false, 12, NULL },
+  { "422", '9', 3, true, true, 3, NULL },
+  { "7003", '9', 4, true, true, 10, NULL },
+  { "8005", '9', 4, true, true, 6, NULL },
+  { "8020", '9', 4, false, false, 25, NULL },
+  { "90", '9', 2, false, false, 30, NULL },
+  { "9", '9', 2, false, false, 90, NULL }, // Company internal 91..99
+};
+
+static bool isDigits(const char *data, uint8_t len) {
+  while (len--) {
+    if ((*data < '0') || (*data > '9'))
+      return false;
+    ++data;
+  }
+
+  return true;
+}
+
+static int8_t findAI(const char *data, uint8_t len) {
+  for (uint8_t i = 0; i < sizeof(GS1_AIS) / sizeof(GS1_AIS[0]); ++i) {
+    _gs1ai_t ai;
+
+    memcpy_P(&ai, &GS1_AIS[i], sizeof(ai));
+
+    uint8_t n = strlen(ai.prefix);
+
+    if ((len >= ai.ailen) && (! strncmp(data, ai.prefix, n)) && ((n >= ai.ailen) || (data[n] <= ai.last)))
+      return i;
+  }
+
+  return -1;
+}
+
+bool decodeGS1(const char *data, uint8_t len, PayloadWriter &writer) {
+  const char *end = data + len;
+
+  while ((data < end) && (*data == GS1_FNC1)) // Leading FNC1
+    ++data;
+  if (data >= end)
+    return false;
+  while (data < end) {
+    int8_t index = findAI(data, end - data);
+
+    if (index < 0)
+      return false;
+
+    _gs1ai_t ai;
+
+    memcpy_P(&ai, &GS1_AIS[index], sizeof(ai));
+    if (! isDigits(data, ai.ailen))
+      return false;
+
+    const char *value = data + ai.ailen;
+    uint8_t vlen = 0;
+
+    if (ai.fixed) {
+      if (end - value < ai.datalen)
+        return false;
+      vlen = ai.datalen;
+    } else {
+      while ((value + vlen < end) && (value[vlen] != GS1_FNC1))
+        ++vlen;
+      if ((! vlen) || (vlen > ai.datalen))
+        return false;
+    }
+    if (ai.numeric && (! isDigits(value, vlen)))
+      return false;
+    if (ai.name)
+      writer.add(ai.name, value, vlen);
+    else
+      writer.add(data, ai.ailen, value, vlen);
+    data = value + vlen;
+    if ((data < end) && (*data == GS1_FNC1)) // Separator after variable (or fixed) length field
+      ++data;
+  }
+
+  return ! writer.overflow();
+}
@@ -0,0 +1,119 @@
+#ifdef ESP32
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+#include "Logger.h"
+
+Logger logger;
+
+bool SerialLogSink::ready(uint8_t len) {
+  uint8_t need = len + 2;
+
+  if (need > TX_FIFO_SIZE) // Longest lines wait for empty FIFO only
+    need = TX_FIFO_SIZE;
+
+  return _serial.availableForWrite() >= need;
+}
+
+void SerialLogSink::write(loglevel_t, const char *line, uint8_t len) {
+  _serial.write((const uint8_t*)line, len);
+  _serial.write('\r');
+  _serial.write('\n');
+}
+
+void SyslogSink::write(loglevel_t level, const char *line, uint8_t len) {
+  static const uint8_t FACILITY_LOCAL0 = 16;
+  static const uint8_t SEVERITIES[] PROGMEM = { 7, 3, 4, 6, 7 }; // Indexed by loglevel_t
+
+  if (_server && WiFi.isConnected()) {
+    char header[48];
+
+    snprintf_P(header, sizeof(header), PSTR("<%u>%s barscanner: "), FACILITY_LOCAL0 * 8 + pgm_read_byte(&SEVERITIES[level]),
+      _hostname ? _hostname : "-");
+    if (_udp.beginPacket(_server, _port)) {
+      _udp.write((const uint8_t*)header, strlen(header));
+      _udp.write((const uint8_t*)line, len);
+      _udp.endPacket();
+    }
+  }
+}
+
+bool Logger::addSink(LogSink *sink) {
+  if (_sinkcount >= MAX_SINKS)
+    return false;
+  _sinks[_sinkcount++] = sink;
+
+  return true;
+}
+
+void Logger::printf_P(loglevel_t level, PGM_P fmt, ...) {
+  char line[LINE_SIZE];
+  va_list args;
+  int len;
+
+  va_start(args, fmt);
+  len = vsnprintf_P(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (len < 0)
+    return;
+  if (len >= LINE_SIZE)
+    len = LINE_SIZE - 1; // Truncated
+  if (_used + 2 + len > RING_SIZE) {
+    ++_dropped;
+    return;
+  }
+
+  uint8_t header[2];
+
+  header[0] = level;
+  header[1] = len;
+  put(header, sizeof(header));
+  put(line, len);
+}
+
+void Logger::drain(uint8_t lines) {
+  while (_used && lines--) {
+    uint16_t tail = (_head + RING_SIZE - _used) % RING_SIZE;
+    uint8_t header[2];
+    char line[LINE_SIZE];
+
+    get(tail, header, sizeof(header));
+    for (uint8_t i = 0; i < _sinkcount; ++i) {
+      if (! _sinks[i]->ready(header[1])) // Keep line in ring until next idle time
+        return;
+    }
+    get((tail + sizeof(header)) % RING_SIZE, line, header[1]);
+    _used -= sizeof(header) + header[1];
+    for (uint8_t i = 0; i < _sinkcount; ++i)
+      _sinks[i]->write((loglevel_t)header[0], line, header[1]);
+  }
+}
+
+void Logger::flush() {
+  while (_used) {
+    drain();
+    yield();
+  }
+}
+
+void Logger::put(const void *data, uint16_t len) {
+  const char *src = (const char*)data;
+
+  while (len--) {
+    _ring[_head] = *src++;
+    if (++_head >= RING_SIZE)
+      _head = 0;
+    ++_used;
+  }
+}
+
+void Logger::get(uint16_t pos, void *data, uint16_t len) const {
+  char *dst = (char*)data;
+
+  while (len--) {
+    *dst++ = _ring[pos];
+    if (++pos >= RING_SIZE)
+      pos = 0;
+  }
+}
@@ -0,0 +1,156 @@
+#include "Lookup.h"
+#include "FileSystem.h"
+
+bool Lookup::begin(const char *path) {
+  char mode[2];
+
+  end();
+  mode[0] = 'r';
+  mode[1] = '\0';
+  _file = FILESYSTEM.open(path, mode);
+  if (! _file)
+    return false;
+  if ((_file.read((uint8_t*)&_header, sizeof(_header)) != sizeof(_header)) || (_header.magic != MAGIC) ||
+    (_header.pagesize > MAX_PAGE_SIZE) || (! _header.keysize) || (_header.keysize + _header.valuesize > _header.pagesize) ||
+    (_header.pagesize / _header.keysize < 2) ||
+    (! _header.count)) {
+    _file.close();
+    return false;
+  }
+  _perpage = _header.pagesize / (_header.keysize + _header.valuesize);
+  _pages[0] = (_header.count + _perpage - 1) / _perpage;
+  _levels = 0;
+
+  uint16_t perindex = _header.pagesize / _header.keysize;
+  uint32_t total = 1 + _pages[0];
+
+  while (_pages[_levels] > 1) {
+    if (_levels >= MAX_LEVELS) {
+      _file.close();
+      return false;
+    }
+    ++_levels;
+    _pages[_levels] = (_pages[_levels - 1] + perindex - 1) / perindex;
+    total += _pages[_levels];
+  }
+  if (total * _header.pagesize > _file.size()) {
+    _file.close();
+    return false;
+  }
+  _starts[_levels] = 1;
+  for (int8_t level = _levels - 1; level >= 0; --level)
+    _starts[level] = _starts[level + 1] + _pages[level + 1];
+  _count = _header.count;
+  invalidate();
+
+  return true;
+}
+
+void Lookup::end() {
+  if (_file)
+    _file.close();
+  _count = 0;
+  invalidate();
+}
+
+bool Lookup::find(const char *key, uint8_t len, char *value) {
+  if ((! _count) || (len > _header.keysize))
+    return false;
+
+  uint8_t padded[256];
+
+  memcpy(padded, key, len);
+  memset(&padded[len], 0, _header.keysize - len);
+
+  uint16_t perindex = _header.pagesize / _header.keysize;
+  uint16_t index = 0; // Page within level, root level has only one page
+
+  for (uint8_t level = _levels; level > 0; --level) { // Pages near the root stay in cache
+    const uint8_t *data = page(_starts[level] + index);
+    uint16_t entries = perindex;
+
+    if (! data)
+      return false;
+    if ((uint32_t)(index + 1) * perindex > _pages[level - 1])
+      entries = _pages[level - 1] - index * perindex;
+
+    int16_t child = search(data, entries, _header.keysize, padded, false);
+
+    if (child < 0)
+      return false;
+    index = index * perindex + child;
+  }
+
+  const uint8_t *data = page(_starts[0] + index);
+  uint16_t records = _perpage;
+
+  if (! data)
+    return false;
+  if ((uint32_t)(index + 1) * _perpage > _count)
+    records = _count - (uint32_t)index * _perpage;
+
+  int16_t record = search(data, records, _header.keysize + _header.valuesize, padded, true);
+
+  if (record < 0)
+    return false;
+  memcpy(value, &data[record * (_header.keysize + _header.valuesize) + _header.keysize], _header.valuesize);
+  value[_header.valuesize] = '\0';
+
+  return true;
+}
+
+int16_t Lookup::search(const uint8_t *data, uint16_t count, uint8_t recsize, const uint8_t *key, bool exact) {
+  int16_t lo = 0, hi = count - 1, result = -1;
+
+  while (lo <= hi) { // Exact match or last entry <= key
+    int16_t mid = (lo + hi) / 2;
+    int cmp = memcmp(&data[mid * recsize], key, _header.keysize);
+
+    if (! cmp)
+      return mid;
+    if (cmp < 0) {
+      result = mid;
+      lo = mid + 1;
+    } else
+      hi = mid - 1;
+  }
+
+  return exact ? -1 : result;
+}
+
+void Lookup::invalidate() {
+  for (uint8_t i = 0; i < CACHE_PAGES; ++i) {
+    _cache[i].page = NO_PAGE;
+    _cache[i].used = 0;
+  }
+}
+
+const uint8_t *Lookup::page(uint16_t index) {
+  uint8_t victim = 0;
+
+  ++_tick;
+  for (uint8_t i = 0; i < CACHE_PAGES; ++i) {
+    if (_cache[i].page == index) {
+      _cache[i].used = _tick;
+
+      return _cache[i].data;
+    }
+  }
+  for (uint8_t i = 0; i < CACHE_PAGES; ++i) { // Free or least recently used page
+    if (_cache[i].page == NO_PAGE) {
+      victim = i;
+      break;
+    }
+    if ((uint16_t)(_tick - _cache[i].used) > (uint16_t)(_tick - _cache[victim].used))
+      victim = i;
+  }
+  _cache[victim].page = NO_PAGE;
+  if ((! _file.seek((uint32_t)index * _header.pagesize, SeekSet)) ||
+    (_file.read(_cache[victim].data, _header.pagesize) != _header.pagesize))
+    return NULL;
+  ++_reads;
+  _cache[victim].page = index;
+  _cache[victim].used = _tick;
+
+  return _cache[victim].data;
+}
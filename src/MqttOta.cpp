@@ -0,0 +1,127 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "MqttOta.h"
+
+static const uint8_t OWN_ERROR = 0xFF;
+
+bool MqttOta::begin(const char *json, size_t len) {
+  StaticJsonDocument<128> doc;
+
+  if (deserializeJson(doc, json, len))
+    return false;
+
+  uint32_t size = doc[F("size")] | 0;
+  const char *md5 = doc[F("md5")] | "";
+
+  if ((_state == OTA_RUNNING) && (size == _size) && (! strcmp(md5, _md5))) // Same image, resume from current offset
+    return true;
+  abort();
+  _start = millis();
+  _offset = 0;
+  _acked = 0;
+  _window = doc[F("window")] | DEF_WINDOW;
+  _size = size;
+  strncpy(_md5, md5, MD5_SIZE);
+  _md5[MD5_SIZE] = '\0';
+#ifndef ESP32
+  Update.runAsync(true); // Written from MQTT callback, must not yield
+#endif
+  if ((! size) || (size > ((ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000)) || (strlen(md5) != MD5_SIZE) || // Hash is mandatory
+    Update.isRunning()) { // Portal upload in progress, not ours to end
+    _state = OTA_FAILED;
+    _error = OWN_ERROR;
+  } else if (! Update.begin(size)) {
+    _state = OTA_FAILED;
+    _error = Update.getError();
+  } else if (! Update.setMD5(_md5)) {
+    _state = OTA_FAILED;
+    _error = Update.getError();
+    Update.end();
+  } else {
+    _state = OTA_RUNNING;
+    _error = 0;
+  }
+
+  return true;
+}
+
+bool MqttOta::write(const uint8_t *data, size_t len, size_t index, size_t total) {
+  size_t fragment = len; // Before offset header is stripped
+
+  if (_state != OTA_RUNNING)
+    return false;
+  if (! index) {
+    bool skip = (len < sizeof(uint32_t)) || ((((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3]) != _offset);
+
+    if (skip) {
+      if (_skip) // Already acked, sender is rewinding
+        return false;
+      _skip = true;
+
+      return true;
+    }
+    _skip = false;
+    data += sizeof(uint32_t);
+    len -= sizeof(uint32_t);
+  } else if (_skip) {
+    return false;
+  }
+  if (len > _size - _offset)
+    len = _size - _offset;
+  if (Update.write((uint8_t*)data, len) != len) {
+    _time = millis() - _start;
+    _state = OTA_FAILED;
+    _error = Update.getError();
+    Update.end();
+
+    return true;
+  }
+  _offset += len;
+  if (index + fragment < total) // Fragment, wait for the rest
+    return false;
+  if (_offset >= _size) {
+    finish();
+
+    return true;
+  }
+  if (_offset - _acked >= _window) {
+    _acked = _offset;
+
+    return true;
+  }
+
+  return false;
+}
+
+void MqttOta::finish() {
+  _time = millis() - _start;
+  if (Update.end()) { // Checks MD5 before commit
+    _state = OTA_DONE;
+  } else {
+    _state = OTA_FAILED;
+    _error = Update.getError();
+  }
+}
+
+void MqttOta::abort() {
+  if (_state == OTA_RUNNING)
+    Update.end(); // Not finished, discards image
+  _state = OTA_IDLE;
+  _skip = false;
+}
+
+uint16_t MqttOta::status(char *json, uint16_t size) const {
+  static const char STATES[][8] PROGMEM = { "idle", "running", "done", "failed" };
+
+  int len = snprintf_P(json, size, PSTR("{\"state\":\"%S\",\"offset\":%u,\"size\":%u,\"ms\":%u"), STATES[_state], _offset, _size,
+    _state == OTA_RUNNING ? (uint32_t)(millis() - _start) : _time);
+
+  if ((_state == OTA_FAILED) && (len < size))
+    len += snprintf_P(&json[len], size - len, PSTR(",\"error\":%u"), _error);
+  if (len < size - 1) {
+    json[len++] = '}';
+    json[len] = '\0';
+  }
+
+  return len < size ? len : size - 1;
+}
@@ -0,0 +1,358 @@
+#include <ESP8266WiFi.h>
+#include "Output.h"
+#include "StrUtils.h"
+#include "Clock.h"
+
+UdpSink::UdpSink(const char *server, uint16_t port, const char *id, bool ack) : _server(server), _id(id), _port(port), _ack(ack),
+  _listening(false), _tries(0), _length(0), _seq(0), _retries(0), _lost(0) {}
+
+bool UdpSink::ready() {
+  return WiFi.isConnected() && (! _tries);
+}
+
+/*
+ * Datagram (big endian): 'B', 'S', version, flags, seq[4], time[8] (ms), idlen, id, payload
+ * Ack: 'B', 'A', seq[4]
+ */
+bool UdpSink::send(const char*, const char *payload, uint16_t len, uint64_t framed) {
+  uint8_t idlen = _id ? strlen(_id) : 0;
+  uint64_t time = sysClock.toWall(framed ? framed : Clock::monotonic());
+  uint8_t *p = _datagram;
+  uint32_t seq = _seq + 1; // Taken only when datagram leaves, requeued message keeps its number
+
+  if (17 + idlen + len > DATAGRAM_SIZE) // Never fits, drop it
+    return true;
+  if (! _listening)
+    _listening = _udp.begin(LOCAL_PORT);
+  *p++ = 'B';
+  *p++ = 'S';
+  *p++ = 1;
+  *p++ = (_ack ? FLAG_ACK : 0) | (sysClock.synced() ? FLAG_SYNCED : 0);
+  for (int8_t i = 3; i >= 0; --i)
+    *p++ = seq >> (i * 8);
+  for (int8_t i = 7; i >= 0; --i)
+    *p++ = time >> (i * 8);
+  *p++ = idlen;
+  memcpy(p, _id, idlen);
+  p += idlen;
+  memcpy(p, payload, len);
+  _length = p + len - _datagram;
+  if (! transmit())
+    return false;
+  _seq = seq;
+  if (_ack)
+    _tries = 1;
+
+  return true;
+}
+
+void UdpSink::process() {
+  if (_listening) {
+    int size;
+
+    while ((size = _udp.parsePacket()) > 0) {
+      uint8_t ack[6];
+
+      if ((_udp.read(ack, sizeof(ack)) == sizeof(ack)) && (ack[0] == 'B') && (ack[1] == 'A') && _tries &&
+        ((((uint32_t)ack[2] << 24) | ((uint32_t)ack[3] << 16) | ((uint32_t)ack[4] << 8) | ack[5]) == _seq))
+        _tries = 0;
+    }
+  }
+  if (_tries && (millis() - _time >= ACK_TIMEOUT)) {
+    if (_tries > MAX_RETRIES) {
+      ++_lost;
+      _tries = 0;
+    } else if (transmit()) {
+      ++_retries;
+      ++_tries;
+    }
+  }
+}
+
+bool UdpSink::transmit() {
+  if (! _udp.beginPacket(_server, _port))
+    return false;
+  _udp.write(_datagram, _length);
+  _time = millis();
+
+  return _udp.endPacket();
+}
+
+HttpSink::HttpSink(const char *url, uint8_t batch) : _host(NULL), _path(NULL), _port(80), _batch(batch ? batch : 1), _count(0),
+  _full(false), _sized(false), _chunked(false), _trailer(false), _state(HTTP_DISCONNECTED), _bodylen(0), _errors(0) {
+  if (! parseUrl(url))
+    _batch = 0; // Never ready
+  _client.onConnect(onConnect, this);
+  _client.onDisconnect(onDisconnect, this);
+  _client.onData(onData, this);
+}
+
+HttpSink::~HttpSink() {
+  _client.close(true);
+  disposeStr(&_host);
+  disposeStr(&_path);
+}
+
+bool HttpSink::ready() {
+  return (_state <= HTTP_IDLE) && (_count < _batch) && (! _full);
+}
+
+bool HttpSink::send(const char*, const char *payload, uint16_t len, uint64_t) {
+  if (_bodylen + len + 1 > BATCH_SIZE) {
+    if (! _count) // Never fits, drop it
+      return true;
+    _full = true;
+    return false;
+  }
+  if (! _count)
+    _time = millis();
+  memcpy(&_body[_bodylen], payload, len);
+  _bodylen += len;
+  _body[_bodylen++] = '\n';
+  ++_count;
+
+  return true;
+}
+
+void HttpSink::process() {
+  if ((_state == HTTP_DISCONNECTED) && _count && WiFi.isConnected()) {
+    if (_client.connect(_host, _port)) {
+      _state = HTTP_CONNECTING;
+      _time = millis();
+    }
+  } else if (_state == HTTP_IDLE) {
+    if (_count && ((_count >= _batch) || _full || (millis() - _time >= BATCH_DELAY)))
+      post();
+  } else if ((_state != HTTP_DISCONNECTED) && (millis() - _time >= RESPONSE_TIMEOUT)) {
+    ++_errors;
+    _client.close(true); // Batch stays for retry after reconnect
+  }
+}
+
+bool HttpSink::parseUrl(const char *url) {
+  const char PREFIX[] = "http://";
+
+  if (strncmp(url, PREFIX, sizeof(PREFIX) - 1))
+    return false;
+  url += sizeof(PREFIX) - 1;
+
+  const char *end = url;
+
+  while (*end && (*end != ':') && (*end != '/'))
+    ++end;
+  _host = (char*)malloc(end - url + 1);
+  if (! _host)
+    return false;
+  memcpy(_host, url, end - url);
+  _host[end - url] = '\0';
+  if (*end == ':') {
+    _port = strtoul(end + 1, (char**)&end, 10);
+  }
+
+  return allocStr(&_path, *end ? end : "/");
+}
+
+void HttpSink::post() {
+  char header[160];
+  int len;
+
+  len = snprintf_P(header, sizeof(header), PSTR("POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/x-ndjson\r\nContent-Length: %u\r\n\r\n"),
+    _path, _host, _bodylen);
+  if ((len >= (int)sizeof(header)) || (_client.space() < (size_t)(len + _bodylen))) // Wait for TCP window
+    return;
+  _client.add(header, len);
+  _client.add(_body, _bodylen);
+  if (_client.send()) {
+    _state = HTTP_HEADERS;
+    _status = 0;
+    _linelen = 0;
+    _time = millis();
+  }
+}
+
+void HttpSink::done(bool success) {
+  if (! success)
+    ++_errors; // Rejected batch is dropped, not retried
+  _bodylen = 0;
+  _count = 0;
+  _full = false;
+  _state = HTTP_IDLE;
+}
+
+bool HttpSink::line(char c) {
+  if (c == '\n') {
+    _line[_linelen] = '\0';
+    _linelen = 0;
+
+    return true;
+  }
+  if ((c != '\r') && (_linelen < sizeof(_line) - 1))
+    _line[_linelen++] = c;
+
+  return false;
+}
+
+void HttpSink::headers() { // Body framing: Content-Length, chunked or until server closes
+  if ((_status >= 100) && (_status < 200)) { // Interim response, real one follows
+    _status = 0;
+  } else if ((_status == 204) || (_status == 304)) {
+    done(true);
+  } else if (_chunked) {
+    _state = HTTP_CHUNKED;
+    _remain = 0;
+    _trailer = false;
+  } else if (_sized) {
+    if (_remain)
+      _state = HTTP_BODY;
+    else
+      done((_status >= 200) && (_status < 300));
+  } else {
+    _state = HTTP_EOF;
+  }
+}
+
+void HttpSink::parse(const char *data, size_t len) {
+  while (len) {
+    if (_state == HTTP_HEADERS) {
+      --len;
+      if (line(*data++)) {
+        if (! *_line) { // End of headers
+          headers();
+        } else if (! _status) {
+          const char *space = strchr(_line, ' ');
+
+          _status = space ? atoi(space + 1) : 0;
+          _remain = 0;
+          _sized = false;
+          _chunked = false;
+        } else if (! strncasecmp_P(_line, PSTR("Content-Length:"), 15)) {
+          _remain = strtoul(&_line[15], NULL, 10);
+          _sized = true;
+        } else if ((! strncasecmp_P(_line, PSTR("Transfer-Encoding:"), 18)) && strstr_P(&_line[18], PSTR("chunked"))) {
+          _chunked = true;
+        }
+      }
+    } else if ((_state == HTTP_BODY) || ((_state == HTTP_CHUNKED) && _remain)) {
+      size_t skip = (len < _remain) ? len : _remain;
+
+      data += skip;
+      len -= skip;
+      _remain -= skip;
+      if ((! _remain) && (_state == HTTP_BODY))
+        done((_status >= 200) && (_status < 300));
+    } else if (_state == HTTP_CHUNKED) {
+      --len;
+      if (line(*data++)) {
+        if (_trailer) {
+          if (! *_line) // Empty line ends trailer
+            done((_status >= 200) && (_status < 300));
+        } else if (*_line) { // Empty line is CR LF after chunk data
+          _remain = strtoul(_line, NULL, 16);
+          if (! _remain)
+            _trailer = true;
+        }
+      }
+    } else // Close delimited body ends with disconnect
+      break;
+  }
+}
+
+void HttpSink::onConnect(void *arg, AsyncClient*) {
+  ((HttpSink*)arg)->_state = HTTP_IDLE;
+}
+
+void HttpSink::onDisconnect(void *arg, AsyncClient*) {
+  HttpSink *_this = (HttpSink*)arg;
+
+  if (_this->_state == HTTP_EOF) // Body without length is complete
+    _this->done((_this->_status >= 200) && (_this->_status < 300));
+  _this->_state = HTTP_DISCONNECTED;
+}
+
+void HttpSink::onData(void *arg, AsyncClient*, void *data, size_t len) {
+  ((HttpSink*)arg)->parse((const char*)data, len);
+}
+
+bool Dispatcher::addSink(OutputSink *sink) {
+  if (_sinkcount >= MAX_SINKS)
+    return false;
+
+  _output_t &output = _outputs[_sinkcount];
+
+  output.ring = (char*)malloc(QUEUE_SIZE);
+  if (! output.ring)
+    return false;
+  output.sink = sink;
+  output.head = 0;
+  output.used = 0;
+  output.dropped = 0;
+  ++_sinkcount;
+
+  return true;
+}
+
+uint8_t Dispatcher::publish(const char *topic, const char *payload, uint16_t len, uint64_t framed) {
+  _header_t header;
+  uint8_t result = 0;
+
+  header.framed = framed;
+  header.len = len;
+  header.topiclen = strlen(topic);
+  for (uint8_t i = 0; i < _sinkcount; ++i) {
+    _output_t &output = _outputs[i];
+
+    if (output.used + sizeof(header) + header.topiclen + len > QUEUE_SIZE) { // Slow sink loses its own messages only
+      ++output.dropped;
+      continue;
+    }
+    put(output, &header, sizeof(header));
+    put(output, topic, header.topiclen);
+    put(output, payload, len);
+    ++result;
+  }
+  process(); // Fast sinks deliver right away
+
+  return result;
+}
+
+void Dispatcher::process() {
+  for (uint8_t i = 0; i < _sinkcount; ++i) {
+    _output_t &output = _outputs[i];
+
+    while (output.used && output.sink->ready()) {
+      uint16_t tail = (output.head + QUEUE_SIZE - output.used) % QUEUE_SIZE;
+      _header_t header;
+
+      get(output, tail, &header, sizeof(header));
+      tail = (tail + sizeof(header)) % QUEUE_SIZE;
+      get(output, tail, _record, header.topiclen); // publish() never queues records larger than ring
+      _record[header.topiclen] = '\0';
+      get(output, (tail + header.topiclen) % QUEUE_SIZE, &_record[header.topiclen + 1], header.len);
+      if (! output.sink->send(_record, &_record[header.topiclen + 1], header.len, header.framed))
+        break;
+      output.used -= sizeof(header) + header.topiclen + header.len;
+    }
+    output.sink->process();
+  }
+}
+
+void Dispatcher::put(_output_t &output, const void *data, uint16_t len) {
+  const char *src = (const char*)data;
+
+  while (len--) {
+    output.ring[output.head] = *src++;
+    if (++output.head >= QUEUE_SIZE)
+      output.head = 0;
+    ++output.used;
+  }
+}
+
+void Dispatcher::get(const _output_t &output, uint16_t pos, void *data, uint16_t len) {
+  char *dst = (char*)data;
+
+  while (len--) {
+    *dst++ = output.ring[pos];
+    if (++pos >= QUEUE_SIZE)
+      pos = 0;
+  }
+}
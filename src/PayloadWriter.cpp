@@ -0,0 +1,145 @@
+#include <Arduino.h>
+#include "PayloadWriter.h"
+
+const char *PayloadWriter::c_str() {
+  if (_length < _size)
+    _buf[_length] = '\0';
+  else if (_size) {
+    _buf[_size - 1] = '\0';
+    _overflow = true;
+  }
+
+  return _buf;
+}
+
+void PayloadWriter::beginMap(PGM_P key) {
+  if (key)
+    putKey(key, strlen_P(key), true);
+  if (_format == PAYLOAD_CBOR)
+    put((CBOR_MAP << 5) | 31); // Indefinite length map, single pass
+  else
+    put('{');
+  if (_depth < 8)
+    _first &= ~(1 << _depth);
+  ++_depth;
+}
+
+void PayloadWriter::endMap() {
+  if (_depth)
+    --_depth;
+  if (_format == PAYLOAD_CBOR)
+    put(CBOR_BREAK);
+  else
+    put('}');
+}
+
+void PayloadWriter::add(PGM_P key, const char *value, uint8_t len, bool progmem) {
+  putKey(key, strlen_P(key), true);
+  putString(value, len, progmem);
+}
+
+void PayloadWriter::add(PGM_P key, uint64_t value) {
+  putKey(key, strlen_P(key), true);
+  if (_format == PAYLOAD_CBOR) {
+    putHead(CBOR_UINT, value);
+  } else if (value <= 0xFFFFFFFF) {
+    char str[11];
+
+    ultoa(value, str, 10);
+    put(str, strlen(str));
+  } else { // Epoch milliseconds
+    char str[20];
+    uint8_t pos = sizeof(str);
+
+    do {
+      str[--pos] = '0' + value % 10;
+      value /= 10;
+    } while (value);
+    put(&str[pos], sizeof(str) - pos);
+  }
+}
+
+void PayloadWriter::add(const char *key, uint8_t keylen, const char *value, uint8_t len) {
+  putKey(key, keylen, false);
+  putString(value, len);
+}
+
+void PayloadWriter::put(char c) {
+  if (_length < _size)
+    _buf[_length++] = c;
+  else
+    _overflow = true;
+}
+
+void PayloadWriter::put(const char *str, uint8_t len, bool progmem) {
+  if (_length + len > _size) {
+    _overflow = true;
+    return;
+  }
+  if (progmem)
+    memcpy_P(&_buf[_length], str, len);
+  else
+    memcpy(&_buf[_length], str, len);
+  _length += len;
+}
+
+void PayloadWriter::putString(const char *str, uint8_t len, bool progmem) {
+  if (_format == PAYLOAD_CBOR) {
+    putHead(CBOR_TEXT, len);
+    put(str, len, progmem);
+  } else {
+    put('"');
+    while (len--) {
+      char c = progmem ? pgm_read_byte(str) : *str;
+
+      if ((c == '"') || (c == '\\')) {
+        put('\\');
+        put(c);
+      } else if ((uint8_t)c < ' ') {
+        char hex[7];
+
+        sprintf_P(hex, PSTR("\\u%04x"), (uint8_t)c);
+        put(hex, 6);
+      } else
+        put(c);
+      ++str;
+    }
+    put('"');
+  }
+}
+
+void PayloadWriter::putKey(const char *key, uint8_t len, bool progmem) {
+  if ((_format != PAYLOAD_CBOR) && _depth && (_depth <= 8)) {
+    uint8_t mask = 1 << (_depth - 1);
+
+    if (_first & mask)
+      put(',');
+    else
+      _first |= mask;
+  }
+  putString(key, len, progmem);
+  if (_format != PAYLOAD_CBOR)
+    put(':');
+}
+
+void PayloadWriter::putHead(uint8_t major, uint64_t value) {
+  major <<= 5;
+  if (value < 24) {
+    put(major | value);
+  } else if (value <= 0xFF) {
+    put(major | 24);
+    put(value);
+  } else if (value <= 0xFFFF) {
+    put(major | 25);
+    put(value >> 8);
+    put(value);
+  } else if (value <= 0xFFFFFFFF) {
+    put(major | 26);
+    for (int8_t i = 3; i >= 0; --i)
+      put(value >> (i * 8));
+  } else {
+    put(major | 27);
+    for (int8_t i = 7; i >= 0; --i)
+      put(value >> (i * 8));
+  }
+}
@@ -0,0 +1,258 @@
+#include <Arduino.h>
+#include "Router.h"
+#include "StrUtils.h"
+
+static const char PREFIX_KEY[] PROGMEM = "prefix";
+static const char MINLEN_KEY[] PROGMEM = "min_len";
+static const char MAXLEN_KEY[] PROGMEM = "max_len";
+static const char SYMBOLOGY_KEY[] PROGMEM = "symbology";
+static const char TOPIC_KEY[] PROGMEM = "topic";
+
+void Router::clear() {
+  List<_route_t, 16>::clear();
+  if (_nodes) {
+    free(_nodes);
+    _nodes = NULL;
+  }
+  _nodecount = 0;
+}
+
+uint8_t Router::add(const char *prefix, uint8_t minlen, uint8_t maxlen, symbology_t symbology, const char *topic) {
+  if ((! topic) || (! *topic) || (strlen(topic) >= TOPIC_SIZE) || (prefix && (strlen(prefix) >= PREFIX_SIZE))) // Longer would not fit JSON_SIZE
+    return ERR_INDEX;
+
+  _route_t r;
+
+  memset(&r, 0, sizeof(r));
+  if ((! allocStr(&r.prefix, prefix)) || (! allocStr(&r.topic, topic))) {
+    disposeStr(&r.prefix);
+    disposeStr(&r.topic);
+    return ERR_INDEX;
+  }
+  r.minlen = minlen;
+  r.maxlen = maxlen;
+  r.symbology = symbology;
+  r.next = NONE;
+
+  uint8_t result = List<_route_t, 16>::add(r);
+
+  if (result == ERR_INDEX) {
+    disposeStr(&r.prefix);
+    disposeStr(&r.topic);
+  }
+
+  return result;
+}
+
+bool Router::compile(const char *client) {
+  uint16_t nodes = 1; // Root
+
+  if (_nodes) {
+    free(_nodes);
+    _nodes = NULL;
+  }
+  _nodecount = 0;
+  if (! _count)
+    return true;
+  for (uint8_t i = 0; i < _count; ++i) {
+    if (_items[i].prefix)
+      nodes += strlen(_items[i].prefix);
+  }
+  if (nodes > NONE)
+    return false;
+  _nodes = (_node_t*)malloc(sizeof(_node_t) * nodes);
+  if (! _nodes)
+    return false;
+  _nodes[0].ch = '\0';
+  _nodes[0].child = _nodes[0].sibling = _nodes[0].route = NONE;
+  _nodecount = 1;
+  for (uint8_t i = 0; i < _count; ++i) {
+    uint8_t node = 0;
+    const char *p = _items[i].prefix;
+
+    while (p && *p) {
+      uint8_t child = findChild(node, *p);
+
+      if (child == NONE) {
+        child = _nodecount++;
+        _nodes[child].ch = *p;
+        _nodes[child].child = _nodes[child].route = NONE;
+        _nodes[child].sibling = _nodes[node].child;
+        _nodes[node].child = child;
+      }
+      node = child;
+      ++p;
+    }
+    if (_nodes[node].route == NONE) { // Keep configuration order of routes on the same node
+      _nodes[node].route = i;
+    } else {
+      uint8_t last = _nodes[node].route;
+
+      while (_items[last].next != NONE)
+        last = _items[last].next;
+      _items[last].next = i;
+    }
+    _items[i].next = NONE;
+    if (_items[i].compiled)
+      free(_items[i].compiled);
+    _items[i].compiled = compileTopic(_items[i].topic, client);
+    if (! _items[i].compiled)
+      return false;
+    _items[i].dynamic = strchr(_items[i].compiled, MARK_SYMBOLOGY) || strchr(_items[i].compiled, MARK_PREFIX4);
+  }
+
+  return true;
+}
+
+uint8_t Router::read(JsonArrayConst routes) {
+  uint8_t result = 0;
+
+  for (JsonObjectConst route : routes) {
+    const char *symbology = route[FPSTR(SYMBOLOGY_KEY)];
+    symbology_t sym = SYM_ANY;
+
+    if (symbology && *symbology) {
+      sym = symbologyFromName(symbology);
+      if ((sym == SYM_UNKNOWN) && strcmp_P(symbology, symbologyName(SYM_UNKNOWN))) { // Misspelled name must not match any
+        ++result;
+        continue;
+      }
+    }
+    if (add(route[FPSTR(PREFIX_KEY)], route[FPSTR(MINLEN_KEY)] | 0, route[FPSTR(MAXLEN_KEY)] | 0, sym, route[FPSTR(TOPIC_KEY)]) == ERR_INDEX)
+      ++result;
+  }
+
+  return result;
+}
+
+void Router::write(JsonArray routes) const {
+  char EMPTY_STR[1];
+
+  EMPTY_STR[0] = '\0'; // ""
+  for (uint8_t i = 0; i < _count; ++i) {
+    JsonObject route = routes.createNestedObject();
+
+    route[FPSTR(PREFIX_KEY)] = _items[i].prefix ? _items[i].prefix : EMPTY_STR;
+    route[FPSTR(MINLEN_KEY)] = _items[i].minlen;
+    route[FPSTR(MAXLEN_KEY)] = _items[i].maxlen;
+    if (_items[i].symbology == SYM_ANY)
+      route[FPSTR(SYMBOLOGY_KEY)] = EMPTY_STR;
+    else
+      route[FPSTR(SYMBOLOGY_KEY)] = FPSTR(symbologyName(_items[i].symbology));
+    route[FPSTR(TOPIC_KEY)] = _items[i].topic;
+  }
+}
+
+const char *Router::route(const char *code, uint8_t len, symbology_t symbology, char *topic) {
+  uint8_t found = NONE;
+  uint8_t node = 0;
+  uint8_t depth = 0;
+
+  if (! _nodes)
+    return NULL;
+  for (;;) { // Single trie walk, the deepest matching route wins
+    for (uint8_t r = _nodes[node].route; r != NONE; r = _items[r].next) {
+      if ((len >= _items[r].minlen) && ((! _items[r].maxlen) || (len <= _items[r].maxlen)) &&
+        ((_items[r].symbology == SYM_ANY) || (_items[r].symbology == symbology))) {
+        found = r;
+        break;
+      }
+    }
+    if (depth >= len)
+      break;
+    node = findChild(node, code[depth++]);
+    if (node == NONE)
+      break;
+  }
+  if (found == NONE)
+    return NULL;
+  if (! _items[found].dynamic)
+    return _items[found].compiled;
+
+  const char *src = _items[found].compiled;
+  uint8_t pos = 0;
+
+  while (*src && (pos < TOPIC_SIZE - 1)) {
+    if (*src == MARK_SYMBOLOGY) {
+      PGM_P name = symbologyName(symbology);
+      uint8_t n = strlen_P(name);
+
+      if (n > TOPIC_SIZE - 1 - pos)
+        n = TOPIC_SIZE - 1 - pos;
+      memcpy_P(&topic[pos], name, n);
+      pos += n;
+    } else if (*src == MARK_PREFIX4) {
+      for (uint8_t i = 0; (i < 4) && (i < len) && (pos < TOPIC_SIZE - 1); ++i) {
+        char c = code[i];
+
+        topic[pos++] = ((c == '/') || (c == '+') || (c == '#') || ((uint8_t)c < ' ')) ? '_' : c; // Keep topic levels intact
+      }
+    } else {
+      topic[pos++] = *src;
+    }
+    ++src;
+  }
+  topic[pos] = '\0';
+
+  return topic;
+}
+
+void Router::cleanup(void *ptr) {
+  _route_t *r = (_route_t*)ptr;
+
+  disposeStr(&r->prefix);
+  disposeStr(&r->topic);
+  disposeStr(&r->compiled);
+}
+
+uint8_t Router::findChild(uint8_t node, char ch) const {
+  for (uint8_t child = _nodes[node].child; child != NONE; child = _nodes[child].sibling) {
+    if (_nodes[child].ch == ch)
+      return child;
+  }
+
+  return NONE;
+}
+
+char *Router::compileTopic(const char *topic, const char *client) {
+  static const char CLIENT_PH[] PROGMEM = "{client}";
+  static const char SYMBOLOGY_PH[] PROGMEM = "{symbology}";
+  static const char PREFIX4_PH[] PROGMEM = "{prefix4}";
+
+  uint16_t size = 1;
+  uint8_t clientlen = client ? strlen(client) : 0;
+
+  for (const char *p = topic; *p; ++p) { // Upper bound of expanded size
+    if (! strncmp_P(p, CLIENT_PH, sizeof(CLIENT_PH) - 1))
+      size += clientlen;
+    else
+      ++size;
+  }
+
+  char *result = (char*)malloc(size);
+
+  if (result) {
+    char *dst = result;
+
+    while (*topic) {
+      if (! strncmp_P(topic, CLIENT_PH, sizeof(CLIENT_PH) - 1)) {
+        if (clientlen) {
+          memcpy(dst, client, clientlen);
+          dst += clientlen;
+        }
+        topic += sizeof(CLIENT_PH) - 1;
+      } else if (! strncmp_P(topic, SYMBOLOGY_PH, sizeof(SYMBOLOGY_PH) - 1)) {
+        *dst++ = MARK_SYMBOLOGY;
+        topic += sizeof(SYMBOLOGY_PH) - 1;
+      } else if (! strncmp_P(topic, PREFIX4_PH, sizeof(PREFIX4_PH) - 1)) {
+        *dst++ = MARK_PREFIX4;
+        topic += sizeof(PREFIX4_PH) - 1;
+      } else {
+        *dst++ = *topic++;
+      }
+    }
+    *dst = '\0';
+  }
+
+  return result;
+}
@@ -3,6 +3,8 @@
 
 bool allocStr(char **str, const char *src) {
   if (src && *src) {
+    if (*str && (! strcmp(*str, src))) // Unchanged, keep buffer others may point to
+      return true;
     if (*str) {
       void *ptr = realloc(*str, strlen(src) + 1);
 
@@ -27,6 +29,8 @@ bool allocStr(char **str, const char *src) {
 
 bool allocStr_P(char **str, PGM_P src) {
   if (src && pgm_read_byte(src)) {
+    if (*str && (! strcmp_P(*str, src)))
+      return true;
     if (*str) {
       void *ptr = realloc(*str, strlen_P(src) + 1);
 
@@ -73,3 +77,35 @@ char *byteToHex(char *out, uint8_t value) {
 
   return out;
 }
+
+static int8_t hexDigit(char c) {
+  if ((c >= '0') && (c <= '9'))
+    return c - '0';
+  if ((c >= 'A') && (c <= 'F'))
+    return c - 'A' + 10;
+  if ((c >= 'a') && (c <= 'f'))
+    return c - 'a' + 10;
+
+  return -1;
+}
+
+uint8_t hexToBytes(uint8_t *out, uint8_t size, const char *hex) {
+  uint8_t len = 0;
+
+  while (*hex) {
+    if ((*hex == ':') || (*hex == ' ')) {
+      ++hex;
+      continue;
+    }
+
+    int8_t hi = hexDigit(hex[0]);
+    int8_t lo = (hi >= 0) ? hexDigit(hex[1]) : -1;
+
+    if ((lo < 0) || (len >= size))
+      return 0;
+    out[len++] = (hi << 4) | lo;
+    hex += 2;
+  }
+
+  return len;
+}
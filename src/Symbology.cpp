@@ -0,0 +1,265 @@
+#include <Arduino.h>
+#include "Symbology.h"
+
+enum checktype_t : uint8_t { CHK_NONE, CHK_MOD10, CHK_UPCE, CHK_GS1 };
+
+struct __packed _aim_t {
+  char code;
+  char modifier; // '*' for any
+  symbology_t symbology;
+};
+
+struct __packed _codeid_t {
+  char code;
+  symbology_t symbology;
+};
+
+struct __packed _symbology_t {
+  uint8_t minlen;
+  uint8_t maxlen;
+  bool digits : 1;
+  checktype_t check : 7;
+};
+
+static const char SYM_UNKNOWN_NAME[] PROGMEM = "unknown";
+static const char SYM_EAN8_NAME[] PROGMEM = "ean8";
+static const char SYM_EAN13_NAME[] PROGMEM = "ean13";
+static const char SYM_UPCA_NAME[] PROGMEM = "upca";
+static const char SYM_UPCE_NAME[] PROGMEM = "upce";
+static const char SYM_ITF14_NAME[] PROGMEM = "itf14";
+static const char SYM_ITF_NAME[] PROGMEM = "itf";
+static const char SYM_CODE128_NAME[] PROGMEM = "code128";
+static const char SYM_GS1_128_NAME[] PROGMEM = "gs1_128";
+static const char SYM_CODE39_NAME[] PROGMEM = "code39";
+static const char SYM_CODABAR_NAME[] PROGMEM = "codabar";
+static const char SYM_QR_NAME[] PROGMEM = "qr";
+static const char SYM_DATAMATRIX_NAME[] PROGMEM = "datamatrix";
+static const char SYM_GS1_DATAMATRIX_NAME[] PROGMEM = "gs1_datamatrix";
+static const char SYM_PDF417_NAME[] PROGMEM = "pdf417";
+
+static PGM_P const SYMBOLOGY_NAMES[] PROGMEM = { SYM_UNKNOWN_NAME, SYM_EAN8_NAME, SYM_EAN13_NAME, SYM_UPCA_NAME, SYM_UPCE_NAME,
+  SYM_ITF14_NAME, SYM_ITF_NAME, SYM_CODE128_NAME, SYM_GS1_128_NAME, SYM_CODE39_NAME, SYM_CODABAR_NAME, SYM_QR_NAME,
+  SYM_DATAMATRIX_NAME, SYM_GS1_DATAMATRIX_NAME, SYM_PDF417_NAME };
+
+// Indexed by symbology_t
+static const _symbology_t SYMBOLOGIES[] PROGMEM = {
+  { 1, 255, false, CHK_NONE }, // SYM_UNKNOWN
+  { 8, 8, true, CHK_MOD10 }, // SYM_EAN8
+  { 13, 13, true, CHK_MOD10 }, // SYM_EAN13
+  { 12, 12, true, CHK_MOD10 }, // SYM_UPCA
+  { 8, 8, true, CHK_UPCE }, // SYM_UPCE
+  { 14, 14, true, CHK_MOD10 }, // SYM_ITF14
+  { 2, 255, true, CHK_NONE }, // SYM_ITF
+  { 1, 255, false, CHK_NONE }, // SYM_CODE128
+  { 2, 255, false, CHK_GS1 }, // SYM_GS1_128
+  { 1, 255, false, CHK_NONE }, // SYM_CODE39
+  { 1, 255, false, CHK_NONE }, // SYM_CODABAR
+  { 1, 255, false, CHK_NONE }, // SYM_QR
+  { 1, 255, false, CHK_NONE }, // SYM_DATAMATRIX
+  { 2, 255, false, CHK_GS1 }, // SYM_GS1_DATAMATRIX
+  { 1, 255, false, CHK_NONE }, // SYM_PDF417
+};
+
+// AIM symbology identifiers (ISO/IEC 15424): "]" + code + modifier
+static const _aim_t AIMS[] PROGMEM = {
+  { 'E', '4', SYM_EAN8 },
+  { 'E', '0', SYM_EAN13 }, // Refined to UPC-A/UPC-E by length
+  { 'I', '1', SYM_ITF14 }, // Refined to ITF by length
+  { 'I', '*', SYM_ITF },
+  { 'C', '1', SYM_GS1_128 },
+  { 'C', '*', SYM_CODE128 },
+  { 'A', '*', SYM_CODE39 },
+  { 'F', '*', SYM_CODABAR },
+  { 'Q', '3', SYM_QR }, // QR with FNC1 in first position is not treated as GS1
+  { 'Q', '*', SYM_QR },
+  { 'd', '2', SYM_GS1_DATAMATRIX },
+  { 'd', '*', SYM_DATAMATRIX },
+  { 'L', '*', SYM_PDF417 },
+};
+
+// GM65 Code ID letters (factory defaults), shared letters are refined by length or leading FNC1
+static const _codeid_t CODE_IDS[] PROGMEM = {
+  { 'd', SYM_EAN13 },
+  { 'c', SYM_UPCA },
+  { 'e', SYM_ITF },
+  { 'j', SYM_CODE128 },
+  { 'b', SYM_CODE39 },
+  { 'a', SYM_CODABAR },
+  { 'Q', SYM_QR },
+  { 'u', SYM_DATAMATRIX },
+  { 'r', SYM_PDF417 },
+};
+
+bool checkMod10(const char *digits, uint8_t len) {
+  if (len < 2)
+    return false;
+
+  uint16_t sum = 0;
+  bool odd = true; // Rightmost data digit has weight 3
+
+  for (int16_t i = len - 2; i >= 0; --i) {
+    sum += (digits[i] - '0') * (odd ? 3 : 1);
+    odd = ! odd;
+  }
+
+  return (digits[len - 1] - '0') == (10 - sum % 10) % 10;
+}
+
+static bool checkUpcE(const char *digits) {
+  char upca[12];
+
+  upca[0] = digits[0]; // Number system
+  switch (digits[6]) {
+    case '0':
+    case '1':
+    case '2':
+      upca[1] = digits[1];
+      upca[2] = digits[2];
+      upca[3] = digits[6];
+      memset(&upca[4], '0', 4);
+      memcpy(&upca[8], &digits[3], 3);
+      break;
+    case '3':
+      memcpy(&upca[1], &digits[1], 3);
+      memset(&upca[4], '0', 5);
+      memcpy(&upca[9], &digits[4], 2);
+      break;
+    case '4':
+      memcpy(&upca[1], &digits[1], 4);
+      memset(&upca[5], '0', 5);
+      upca[10] = digits[5];
+      break;
+    default:
+      memcpy(&upca[1], &digits[1], 5);
+      memset(&upca[6], '0', 4);
+      upca[10] = digits[6];
+      break;
+  }
+  upca[11] = digits[7];
+
+  return checkMod10(upca, sizeof(upca));
+}
+
+static bool isDigits(const char *code, uint8_t len) {
+  while (len--) {
+    if ((*code < '0') || (*code > '9'))
+      return false;
+    ++code;
+  }
+
+  return true;
+}
+
+static bool checkGS1(const char *code, uint8_t len) {
+  if (*code == GS1_FNC1) { // Leading FNC1 may be transmitted
+    ++code;
+    --len;
+  }
+  if ((len < 2) || (! isDigits(code, 2)))
+    return false;
+  if ((code[0] == '0') && ((code[1] == '0') || (code[1] == '1'))) { // SSCC or GTIN
+    uint8_t n = (code[1] == '0') ? 18 : 14;
+
+    if ((len < n + 2) || (! isDigits(&code[2], n)) || (! checkMod10(&code[2], n)))
+      return false;
+  }
+
+  return true;
+}
+
+bool classifyBarcode(const char *code, uint8_t len, barcodeinfo_t *info, uint8_t flags) {
+  info->symbology = SYM_UNKNOWN;
+  info->offset = 0;
+  info->length = len;
+  info->valid = false;
+
+  if ((flags & CLASSIFY_CODE_ID) && (len >= 2)) { // Letters of other symbologies are stripped too
+    for (uint8_t i = 0; i < sizeof(CODE_IDS) / sizeof(CODE_IDS[0]); ++i) {
+      if (pgm_read_byte(&CODE_IDS[i].code) == code[0]) {
+        info->symbology = (symbology_t)pgm_read_byte(&CODE_IDS[i].symbology);
+        break;
+      }
+    }
+    info->offset = 1;
+    info->length = len - 1;
+    if ((info->symbology == SYM_EAN13) && (info->length == 8))
+      info->symbology = SYM_EAN8;
+    else if ((info->symbology == SYM_UPCA) && (info->length == 8))
+      info->symbology = SYM_UPCE;
+    else if ((info->symbology == SYM_ITF) && (info->length == 14))
+      info->symbology = SYM_ITF14;
+    else if ((info->symbology == SYM_CODE128) && (code[1] == GS1_FNC1))
+      info->symbology = SYM_GS1_128;
+    else if ((info->symbology == SYM_DATAMATRIX) && (code[1] == GS1_FNC1))
+      info->symbology = SYM_GS1_DATAMATRIX;
+  } else if ((len >= 3) && (code[0] == ']')) {
+    for (uint8_t i = 0; i < sizeof(AIMS) / sizeof(AIMS[0]); ++i) {
+      char modifier = pgm_read_byte(&AIMS[i].modifier);
+
+      if ((pgm_read_byte(&AIMS[i].code) == code[1]) && ((modifier == '*') || (modifier == code[2]))) {
+        info->symbology = (symbology_t)pgm_read_byte(&AIMS[i].symbology);
+        break;
+      }
+    }
+    info->offset = 3;
+    info->length = len - 3;
+    if (info->symbology == SYM_EAN13) {
+      if (info->length == 12)
+        info->symbology = SYM_UPCA;
+      else if (info->length == 8)
+        info->symbology = SYM_UPCE;
+    } else if ((info->symbology == SYM_ITF14) && (info->length != 14)) {
+      info->symbology = SYM_ITF;
+    }
+  } else if ((flags & CLASSIFY_GUESS) && isDigits(code, len)) { // UPC-E and numeric Code 128 may have these lengths too
+    if (len == 8)
+      info->symbology = SYM_EAN8;
+    else if (len == 12)
+      info->symbology = SYM_UPCA;
+    else if (len == 13)
+      info->symbology = SYM_EAN13;
+    else if (len == 14)
+      info->symbology = SYM_ITF14;
+  }
+
+  const char *data = &code[info->offset];
+
+  for (uint8_t i = 0; i < info->length; ++i) { // Line noise
+    if (((uint8_t)data[i] < ' ') && (data[i] != GS1_FNC1))
+      return false;
+  }
+
+  _symbology_t sym;
+
+  memcpy_P(&sym, &SYMBOLOGIES[info->symbology], sizeof(sym));
+  if ((info->length < sym.minlen) || (info->length > sym.maxlen))
+    return false;
+  if (sym.digits && (! isDigits(data, info->length)))
+    return false;
+  if (sym.check == CHK_MOD10)
+    info->valid = checkMod10(data, info->length);
+  else if (sym.check == CHK_UPCE)
+    info->valid = checkUpcE(data);
+  else if (sym.check == CHK_GS1)
+    info->valid = checkGS1(data, info->length);
+  else
+    info->valid = true;
+
+  return info->valid;
+}
+
+PGM_P symbologyName(symbology_t symbology) {
+  if (symbology >= sizeof(SYMBOLOGY_NAMES) / sizeof(SYMBOLOGY_NAMES[0]))
+    symbology = SYM_UNKNOWN;
+
+  return (PGM_P)pgm_read_ptr(&SYMBOLOGY_NAMES[symbology]);
+}
+
+symbology_t symbologyFromName(const char *name) {
+  for (uint8_t i = 0; i < sizeof(SYMBOLOGY_NAMES) / sizeof(SYMBOLOGY_NAMES[0]); ++i) {
+    if (! strcmp_P(name, (PGM_P)pgm_read_ptr(&SYMBOLOGY_NAMES[i])))
+      return (symbology_t)i;
+  }
+
+  return SYM_UNKNOWN;
+}
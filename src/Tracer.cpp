@@ -0,0 +1,50 @@
+#include <Arduino.h>
+#include "Tracer.h"
+
+void Histogram::clear() {
+  memset(_buckets, 0, sizeof(_buckets));
+  _count = 0;
+  _max = 0;
+}
+
+void Histogram::add(uint32_t us) {
+  uint8_t bucket = 0;
+
+  while ((bucket < BUCKETS - 1) && (us >= (BASE << bucket)))
+    ++bucket;
+  ++_buckets[bucket];
+  ++_count;
+  if (us > _max)
+    _max = us;
+}
+
+void Tracer::clear() {
+  memset(_inflight, 0, sizeof(_inflight));
+  _next = 0;
+}
+
+void Tracer::handoff(uint64_t framed, uint16_t packetId) {
+  uint64_t now = micros64();
+
+  _publish.add(now - framed);
+  if (packetId) {
+    if (_inflight[_next].packetId) // Oldest packet never acked
+      ++_lost;
+    _inflight[_next].packetId = packetId;
+    _inflight[_next].time = now;
+    _next = (_next + 1) % INFLIGHT;
+  }
+}
+
+bool Tracer::ack(uint16_t packetId) {
+  for (uint8_t i = 0; i < INFLIGHT; ++i) {
+    if (_inflight[i].packetId == packetId) {
+      _acked.add((uint32_t)micros64() - _inflight[i].time);
+      _inflight[i].packetId = 0;
+
+      return true;
+    }
+  }
+
+  return false;
+}
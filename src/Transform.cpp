@@ -0,0 +1,239 @@
+#include <string.h>
+#include <stdlib.h>
+#include <pgmspace.h>
+#include "Transform.h"
+
+uint8_t Transform::charClass(char c) {
+  uint8_t u = c;
+
+  if (u >= 0x80)
+    return CLASS_HIGH;
+  if ((u < ' ') || (u == 0x7F))
+    return CLASS_CTRL;
+  if (u == ' ')
+    return CLASS_SPACE;
+  if ((u >= '0') && (u <= '9'))
+    return CLASS_DIGIT;
+  if (((u >= 'A') && (u <= 'Z')) || ((u >= 'a') && (u <= 'z')))
+    return CLASS_ALPHA;
+
+  return CLASS_PUNCT;
+}
+
+static int8_t hexDigit(char c) {
+  if ((c >= '0') && (c <= '9'))
+    return c - '0';
+  c |= 0x20;
+  if ((c >= 'a') && (c <= 'f'))
+    return c - 'a' + 10;
+
+  return -1;
+}
+
+const char *Transform::token(const char *source, char *out, uint8_t size, uint8_t *len) { // NULL on error
+  *len = 0;
+  while (*source == ' ')
+    ++source;
+  while (*source && (*source != ' ') && (*source != ';')) {
+    char c = *source++;
+
+    if (c == '\\') {
+      c = *source++;
+      if (c == 's')
+        c = ' ';
+      else if (c == 't')
+        c = '\t';
+      else if (c == 'r')
+        c = '\r';
+      else if (c == 'n')
+        c = '\n';
+      else if (c == 'x') {
+        int8_t hi = hexDigit(source[0]);
+        int8_t lo = (hi >= 0) ? hexDigit(source[1]) : -1;
+
+        if (lo < 0)
+          return NULL;
+        c = (hi << 4) | lo;
+        source += 2;
+      } else if ((c != '\\') && (c != ';'))
+        return NULL;
+    }
+    if (*len >= size - 1)
+      return NULL;
+    out[(*len)++] = c;
+  }
+  out[*len] = '\0';
+
+  return source;
+}
+
+uint8_t Transform::parseClasses(const char *arg) {
+  static const char NAMES[][6] PROGMEM = { "ctrl", "space", "alpha", "digit", "punct", "high" };
+
+  uint8_t result = 0;
+
+  while (*arg) {
+    const char *end = strchr(arg, ',');
+    uint8_t len = end ? end - arg : strlen(arg);
+    uint8_t i;
+
+    for (i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); ++i) {
+      if ((strlen_P(NAMES[i]) == len) && (! strncmp_P(arg, NAMES[i], len)))
+        break;
+    }
+    if (i >= sizeof(NAMES) / sizeof(NAMES[0]))
+      return 0;
+    result |= 1 << i;
+    arg += len;
+    if (*arg == ',')
+      ++arg;
+  }
+
+  return result;
+}
+
+const char *Transform::compileOp(const char *source, uint8_t *pos) { // Returns next operation, NULL on error
+  char op[8], arg[32], arg2[8];
+  uint8_t oplen, len, len2;
+
+  source = token(source, op, sizeof(op), &oplen);
+  if (! source)
+    return NULL;
+  if (! oplen) // Empty operation or trailing ';'
+    return (*source == ';') ? source + 1 : source;
+  source = token(source, arg, sizeof(arg), &len);
+  if (! source)
+    return NULL;
+  source = token(source, arg2, sizeof(arg2), &len2);
+  if ((! source) || (*pos + 3 + len >= SIZE)) // Leave room for OP_END
+    return NULL;
+  if ((! strcmp_P(op, PSTR("lstrip"))) || (! strcmp_P(op, PSTR("rstrip")))) {
+    if ((! len) || len2)
+      return NULL;
+    _code[(*pos)++] = (op[0] == 'l') ? OP_LSTRIP : OP_RSTRIP;
+    _code[(*pos)++] = len;
+    memcpy(&_code[*pos], arg, len);
+    *pos += len;
+  } else if (! strcmp_P(op, PSTR("substr"))) {
+    if (! len)
+      return NULL;
+    _code[(*pos)++] = OP_SUBSTR;
+    _code[(*pos)++] = atoi(arg);
+    _code[(*pos)++] = len2 ? atoi(arg2) : 0; // 0 means up to end
+  } else if ((! strcmp_P(op, PSTR("upper"))) || (! strcmp_P(op, PSTR("lower")))) {
+    if (len)
+      return NULL;
+    _code[(*pos)++] = (op[0] == 'u') ? OP_UPPER : OP_LOWER;
+  } else if ((! strcmp_P(op, PSTR("remove"))) || (! strcmp_P(op, PSTR("keep")))) {
+    uint8_t classes = parseClasses(arg);
+
+    if ((! classes) || len2)
+      return NULL;
+    _code[(*pos)++] = OP_REMOVE;
+    _code[(*pos)++] = (op[0] == 'r') ? classes : ~classes;
+  } else if (! strcmp_P(op, PSTR("replace"))) {
+    if ((len != 1) || (len2 > 1))
+      return NULL;
+    if (len2) {
+      _code[(*pos)++] = OP_REPLACE;
+      _code[(*pos)++] = arg[0];
+      _code[(*pos)++] = arg2[0];
+    } else {
+      _code[(*pos)++] = OP_DELETE;
+      _code[(*pos)++] = arg[0];
+    }
+  } else
+    return NULL;
+  while (*source == ' ')
+    ++source;
+  if (*source == ';')
+    return source + 1;
+
+  return *source ? NULL : source; // Extra argument
+}
+
+bool Transform::compile(const char *source) {
+  uint8_t pos = 0;
+
+  clear();
+  if (! source) // No transform configured
+    return true;
+  while (*source) {
+    source = compileOp(source, &pos);
+    if (! source) {
+      clear(); // Partially compiled program must not run
+      return false;
+    }
+  }
+  _code[pos] = OP_END;
+
+  return true;
+}
+
+uint8_t Transform::apply(char *code, uint8_t len) const {
+  const uint8_t *pc = _code;
+
+  for (;;) {
+    switch (*pc++) {
+      case OP_LSTRIP:
+        if ((len >= pc[0]) && (! memcmp(code, &pc[1], pc[0]))) {
+          len -= pc[0];
+          memmove(code, &code[pc[0]], len);
+        }
+        pc += 1 + pc[0];
+        break;
+      case OP_RSTRIP:
+        if ((len >= pc[0]) && (! memcmp(&code[len - pc[0]], &pc[1], pc[0])))
+          len -= pc[0];
+        pc += 1 + pc[0];
+        break;
+      case OP_SUBSTR:
+        if (pc[0] >= len) {
+          len = 0;
+        } else {
+          len -= pc[0];
+          memmove(code, &code[pc[0]], len);
+          if (pc[1] && (pc[1] < len))
+            len = pc[1];
+        }
+        pc += 2;
+        break;
+      case OP_UPPER:
+        for (uint8_t i = 0; i < len; ++i) {
+          if ((code[i] >= 'a') && (code[i] <= 'z'))
+            code[i] -= 'a' - 'A';
+        }
+        break;
+      case OP_LOWER:
+        for (uint8_t i = 0; i < len; ++i) {
+          if ((code[i] >= 'A') && (code[i] <= 'Z'))
+            code[i] += 'a' - 'A';
+        }
+        break;
+      case OP_REMOVE:
+      case OP_DELETE:
+        {
+          uint8_t out = 0;
+
+          for (uint8_t i = 0; i < len; ++i) {
+            if ((pc[-1] == OP_REMOVE) ? (! (charClass(code[i]) & pc[0])) : (code[i] != (char)pc[0]))
+              code[out++] = code[i];
+          }
+          len = out;
+        }
+        pc += 1;
+        break;
+      case OP_REPLACE:
+        for (uint8_t i = 0; i < len; ++i) {
+          if (code[i] == (char)pc[0])
+            code[i] = pc[1];
+        }
+        pc += 2;
+        break;
+      default: // OP_END
+        code[len] = '\0';
+
+        return len;
+    }
+  }
+}
@@ -3,22 +3,52 @@
 #include <AsyncMqttClient.h>
 #include "StrUtils.h"
 #include "BaseConfig.h"
+#include "FileSystem.h"
 #include "CaptivePortal.h"
 #include "Buttons.h"
 #include "Leds.h"
+#include "Dedup.h"
+#include "Symbology.h"
+#include "PayloadWriter.h"
+#include "GS1.h"
+#include "Router.h"
+#include "Lookup.h"
+#include "GM65.h"
+#include "Logger.h"
+#include "Clock.h"
+#include "Tracer.h"
+#include "Output.h"
+#include "Transform.h"
+#include "MqttOta.h"
 
-#define MQTT_QOS 0
-
+#ifdef ONE_BUTTON
 const uint8_t BTN_PIN = 0;
+#else
+const uint8_t BTN_PINS[] = { 0, 4, 5 }; // GPIO4 and GPIO5 on boards with them wired out
+const uint8_t BTN_COUNT = sizeof(BTN_PINS);
+#endif
 const uint8_t LED_PIN = 2;
 const bool LED_LEVEL = LOW;
 
 const uint8_t BARCODE_SIZE = 127;
 const char BARCODE_TERMINATOR = '\r';
+const uint8_t BARCODE_GAP = 20; // 20 ms. of silence ends frame when scanner sends no terminator
+const uint16_t MIN_UART_RX_BUFFER = BARCODE_SIZE + 1; // Whole frame must fit
+const uint16_t MAX_UART_RX_BUFFER = 4096;
+const uint16_t PAYLOAD_SIZE = 256;
+
+const uint8_t PAYLOAD_SEQ = 0x01;
+const uint8_t PAYLOAD_TIME = 0x02;
+const uint8_t PAYLOAD_SYMBOLOGY = 0x04;
+const uint8_t PAYLOAD_CLIENT = 0x08;
+const uint8_t PAYLOAD_TRACE = 0x10;
 
 class Config : public BaseConfig {
 public:
   void clear();
+  uint16_t jsonSize() const {
+    return JSON_BUF_SIZE + Router::MAX_ROUTES * Router::JSON_SIZE;
+  }
 
   struct __packed {
     char *_wifi_ssid;
@@ -29,9 +59,48 @@ public:
     char *_mqtt_client;
     char *_mqtt_barcode_topic;
     char *_mqtt_button_topic;
+    char *_mqtt_stats_topic;
+    char *_mqtt_error_topic;
+    char *_lookup_file;
+    char *_mqtt_log_topic;
+    char *_syslog_server;
+    char *_ntp_server;
+    char *_mqtt_fingerprint;
+    char *_mqtt_status_topic;
+    char *_http_url;
+    char *_udp_server;
+    char *_barcode_transform;
+    char *_mqtt_config_topic;
+    char *_mqtt_ota_topic;
     uint16_t _mqtt_port;
     bool _mqtt_retained;
+    dedupmode_t _dedup_mode;
+    uint16_t _dedup_window;
+    bool _barcode_validate;
+    bool _barcode_guess;
+    payloadformat_t _gs1_decode;
+    payloadformat_t _mqtt_barcode_format;
+    payloadformat_t _mqtt_button_format;
+    uint8_t _mqtt_barcode_fields;
+    uint8_t _mqtt_button_fields;
+    uint32_t _gm65_baud;
+    gm65mode_t _gm65_mode;
+    gm65tail_t _gm65_tail;
+    bool _gm65_code_id;
+    uint16_t _gm65_symbologies;
+    bool _gm65_save;
+    uint16_t _uart_rx_buffer;
+    uint16_t _syslog_port;
+    uint8_t _mqtt_qos;
+    bool _mqtt_secure;
+    bool _mqtt_clean_session;
+    uint16_t _mqtt_keepalive;
+    uint8_t _http_batch;
+    uint16_t _udp_port;
+    bool _udp_ack;
   };
+  Router _mqtt_routes;
+  Transform _transform; // Compiled _barcode_transform
 
 protected:
   void read(const JsonDocument &doc);
@@ -50,6 +119,44 @@ static const char MQTT_CLIENT_PARAM[] PROGMEM = "mqtt_client";
 static const char MQTT_RETAINED_PARAM[] PROGMEM = "mqtt_retained";
 static const char MQTT_BARCODE_TOPIC_PARAM[] PROGMEM = "mqtt_barcode_topic";
 static const char MQTT_BUTTON_TOPIC_PARAM[] PROGMEM = "mqtt_button_topic";
+static const char MQTT_STATS_TOPIC_PARAM[] PROGMEM = "mqtt_stats_topic";
+static const char DEDUP_MODE_PARAM[] PROGMEM = "dedup_mode";
+static const char DEDUP_WINDOW_PARAM[] PROGMEM = "dedup_window";
+static const char MQTT_ERROR_TOPIC_PARAM[] PROGMEM = "mqtt_error_topic";
+static const char BARCODE_VALIDATE_PARAM[] PROGMEM = "barcode_validate";
+static const char BARCODE_GUESS_PARAM[] PROGMEM = "barcode_guess";
+static const char GS1_DECODE_PARAM[] PROGMEM = "gs1_decode";
+static const char MQTT_BARCODE_FORMAT_PARAM[] PROGMEM = "mqtt_barcode_format";
+static const char MQTT_BUTTON_FORMAT_PARAM[] PROGMEM = "mqtt_button_format";
+static const char MQTT_BARCODE_FIELDS_PARAM[] PROGMEM = "mqtt_barcode_fields";
+static const char MQTT_BUTTON_FIELDS_PARAM[] PROGMEM = "mqtt_button_fields";
+static const char LOOKUP_FILE_PARAM[] PROGMEM = "lookup_file";
+static const char GM65_BAUD_PARAM[] PROGMEM = "gm65_baud";
+static const char GM65_MODE_PARAM[] PROGMEM = "gm65_mode";
+static const char GM65_TAIL_PARAM[] PROGMEM = "gm65_tail";
+static const char GM65_CODE_ID_PARAM[] PROGMEM = "gm65_code_id";
+static const char GM65_SYMBOLOGIES_PARAM[] PROGMEM = "gm65_symbologies";
+static const char GM65_SAVE_PARAM[] PROGMEM = "gm65_save";
+static const char UART_RX_BUFFER_PARAM[] PROGMEM = "uart_rx_buffer";
+static const char MQTT_LOG_TOPIC_PARAM[] PROGMEM = "mqtt_log_topic";
+static const char SYSLOG_SERVER_PARAM[] PROGMEM = "syslog_server";
+static const char SYSLOG_PORT_PARAM[] PROGMEM = "syslog_port";
+static const char MQTT_QOS_PARAM[] PROGMEM = "mqtt_qos";
+static const char NTP_SERVER_PARAM[] PROGMEM = "ntp_server";
+static const char MQTT_SECURE_PARAM[] PROGMEM = "mqtt_secure";
+static const char MQTT_FINGERPRINT_PARAM[] PROGMEM = "mqtt_fingerprint";
+static const char MQTT_STATUS_TOPIC_PARAM[] PROGMEM = "mqtt_status_topic";
+static const char MQTT_CLEAN_SESSION_PARAM[] PROGMEM = "mqtt_clean_session";
+static const char MQTT_KEEPALIVE_PARAM[] PROGMEM = "mqtt_keepalive";
+static const char HTTP_URL_PARAM[] PROGMEM = "http_url";
+static const char UDP_SERVER_PARAM[] PROGMEM = "udp_server";
+static const char HTTP_BATCH_PARAM[] PROGMEM = "http_batch";
+static const char UDP_PORT_PARAM[] PROGMEM = "udp_port";
+static const char UDP_ACK_PARAM[] PROGMEM = "udp_ack";
+static const char BARCODE_TRANSFORM_PARAM[] PROGMEM = "barcode_transform";
+static const char MQTT_CONFIG_TOPIC_PARAM[] PROGMEM = "mqtt_config_topic";
+static const char MQTT_OTA_TOPIC_PARAM[] PROGMEM = "mqtt_ota_topic";
+static const char MQTT_ROUTES_PARAM[] PROGMEM = "mqtt_routes";
 
 //#define DEF_WIFI_SSID "ssid"
 //#define DEF_WIFI_PSWD "pswd"
@@ -61,6 +168,43 @@ static const char MQTT_BUTTON_TOPIC_PARAM[] PROGMEM = "mqtt_button_topic";
 //#define DEF_MQTT_RETAINED true
 #define DEF_MQTT_BARCODE_TOPIC "/barcode"
 #define DEF_MQTT_BUTTON_TOPIC "/button"
+//#define DEF_MQTT_STATS_TOPIC "/stats"
+//#define DEF_DEDUP_MODE DEDUP_GLOBAL
+#define DEF_DEDUP_WINDOW 1000
+//#define DEF_MQTT_ERROR_TOPIC "/barcode/error"
+//#define DEF_BARCODE_VALIDATE true
+//#define DEF_BARCODE_GUESS true
+//#define DEF_GS1_DECODE PAYLOAD_JSON
+//#define DEF_MQTT_BARCODE_FORMAT PAYLOAD_JSON
+//#define DEF_MQTT_BUTTON_FORMAT PAYLOAD_JSON
+#define DEF_MQTT_BARCODE_FIELDS (PAYLOAD_SEQ | PAYLOAD_TIME | PAYLOAD_SYMBOLOGY)
+#define DEF_MQTT_BUTTON_FIELDS (PAYLOAD_SEQ | PAYLOAD_TIME)
+//#define DEF_LOOKUP_FILE "/lookup.idx"
+//#define DEF_MQTT_OTA_TOPIC "/ota"
+//#define DEF_MQTT_CONFIG_TOPIC "/config"
+//#define DEF_BARCODE_TRANSFORM "lstrip ]C1; remove ctrl"
+#define DEF_UDP_ACK false
+//#define DEF_HTTP_URL "http://192.168.1.1:8080/scans"
+//#define DEF_UDP_SERVER "239.1.2.3"
+#define DEF_HTTP_BATCH 8
+#define DEF_UDP_PORT 5000
+//#define DEF_MQTT_STATUS_TOPIC "/status"
+#define DEF_MQTT_CLEAN_SESSION true
+#define DEF_MQTT_KEEPALIVE 15
+#define DEF_MQTT_SECURE false
+//#define DEF_MQTT_FINGERPRINT "00:11:22:33:44:55:66:77:88:99:AA:BB:CC:DD:EE:FF:00:11:22:33"
+#define DEF_MQTT_QOS 0
+#define DEF_NTP_SERVER "pool.ntp.org"
+//#define DEF_MQTT_LOG_TOPIC "/log"
+//#define DEF_SYSLOG_SERVER "192.168.1.1"
+#define DEF_SYSLOG_PORT 514
+#define DEF_UART_RX_BUFFER 256
+//#define DEF_GM65_BAUD 115200
+//#define DEF_GM65_MODE GM65_MANUAL
+//#define DEF_GM65_TAIL GM65_TAIL_CR
+//#define DEF_GM65_CODE_ID true
+//#define DEF_GM65_SYMBOLOGIES 0xFFFF
+//#define DEF_GM65_SAVE true
 
 void Config::clear() {
 #ifdef DEF_WIFI_SSID
@@ -113,6 +257,193 @@ void Config::clear() {
 #else
   disposeStr(&_mqtt_button_topic);
 #endif
+#ifdef DEF_MQTT_STATS_TOPIC
+  allocStr_P(&_mqtt_stats_topic, PSTR(DEF_MQTT_STATS_TOPIC));
+#else
+  disposeStr(&_mqtt_stats_topic);
+#endif
+#ifdef DEF_DEDUP_MODE
+  _dedup_mode = DEF_DEDUP_MODE;
+#else
+  _dedup_mode = DEDUP_OFF;
+#endif
+#ifdef DEF_DEDUP_WINDOW
+  _dedup_window = DEF_DEDUP_WINDOW;
+#else
+  _dedup_window = 0;
+#endif
+#ifdef DEF_MQTT_ERROR_TOPIC
+  allocStr_P(&_mqtt_error_topic, PSTR(DEF_MQTT_ERROR_TOPIC));
+#else
+  disposeStr(&_mqtt_error_topic);
+#endif
+#ifdef DEF_BARCODE_VALIDATE
+  _barcode_validate = DEF_BARCODE_VALIDATE;
+#else
+  _barcode_validate = false;
+#endif
+#ifdef DEF_BARCODE_GUESS
+  _barcode_guess = DEF_BARCODE_GUESS;
+#else
+  _barcode_guess = false;
+#endif
+#ifdef DEF_GS1_DECODE
+  _gs1_decode = DEF_GS1_DECODE;
+#else
+  _gs1_decode = PAYLOAD_RAW;
+#endif
+#ifdef DEF_MQTT_BARCODE_FORMAT
+  _mqtt_barcode_format = DEF_MQTT_BARCODE_FORMAT;
+#else
+  _mqtt_barcode_format = PAYLOAD_RAW;
+#endif
+#ifdef DEF_MQTT_BUTTON_FORMAT
+  _mqtt_button_format = DEF_MQTT_BUTTON_FORMAT;
+#else
+  _mqtt_button_format = PAYLOAD_RAW;
+#endif
+#ifdef DEF_MQTT_BARCODE_FIELDS
+  _mqtt_barcode_fields = DEF_MQTT_BARCODE_FIELDS;
+#else
+  _mqtt_barcode_fields = 0;
+#endif
+#ifdef DEF_MQTT_BUTTON_FIELDS
+  _mqtt_button_fields = DEF_MQTT_BUTTON_FIELDS;
+#else
+  _mqtt_button_fields = 0;
+#endif
+#ifdef DEF_LOOKUP_FILE
+  allocStr_P(&_lookup_file, PSTR(DEF_LOOKUP_FILE));
+#else
+  disposeStr(&_lookup_file);
+#endif
+#ifdef DEF_GM65_BAUD
+  _gm65_baud = DEF_GM65_BAUD;
+#else
+  _gm65_baud = 0;
+#endif
+#ifdef DEF_GM65_MODE
+  _gm65_mode = DEF_GM65_MODE;
+#else
+  _gm65_mode = GM65_KEEP;
+#endif
+#ifdef DEF_GM65_TAIL
+  _gm65_tail = DEF_GM65_TAIL;
+#else
+  _gm65_tail = GM65_TAIL_KEEP;
+#endif
+#ifdef DEF_GM65_CODE_ID
+  _gm65_code_id = DEF_GM65_CODE_ID;
+#else
+  _gm65_code_id = false;
+#endif
+#ifdef DEF_GM65_SYMBOLOGIES
+  _gm65_symbologies = DEF_GM65_SYMBOLOGIES;
+#else
+  _gm65_symbologies = 0;
+#endif
+#ifdef DEF_GM65_SAVE
+  _gm65_save = DEF_GM65_SAVE;
+#else
+  _gm65_save = false;
+#endif
+#ifdef DEF_UART_RX_BUFFER
+  _uart_rx_buffer = DEF_UART_RX_BUFFER;
+#else
+  _uart_rx_buffer = 256;
+#endif
+#ifdef DEF_MQTT_LOG_TOPIC
+  allocStr_P(&_mqtt_log_topic, PSTR(DEF_MQTT_LOG_TOPIC));
+#else
+  disposeStr(&_mqtt_log_topic);
+#endif
+#ifdef DEF_SYSLOG_SERVER
+  allocStr_P(&_syslog_server, PSTR(DEF_SYSLOG_SERVER));
+#else
+  disposeStr(&_syslog_server);
+#endif
+#ifdef DEF_SYSLOG_PORT
+  _syslog_port = DEF_SYSLOG_PORT;
+#else
+  _syslog_port = 514;
+#endif
+#ifdef DEF_MQTT_QOS
+  _mqtt_qos = DEF_MQTT_QOS;
+#else
+  _mqtt_qos = 0;
+#endif
+#ifdef DEF_NTP_SERVER
+  allocStr_P(&_ntp_server, PSTR(DEF_NTP_SERVER));
+#else
+  disposeStr(&_ntp_server);
+#endif
+#ifdef DEF_MQTT_SECURE
+  _mqtt_secure = DEF_MQTT_SECURE;
+#else
+  _mqtt_secure = false;
+#endif
+#ifdef DEF_MQTT_FINGERPRINT
+  allocStr_P(&_mqtt_fingerprint, PSTR(DEF_MQTT_FINGERPRINT));
+#else
+  disposeStr(&_mqtt_fingerprint);
+#endif
+#ifdef DEF_MQTT_STATUS_TOPIC
+  allocStr_P(&_mqtt_status_topic, PSTR(DEF_MQTT_STATUS_TOPIC));
+#else
+  disposeStr(&_mqtt_status_topic);
+#endif
+#ifdef DEF_MQTT_CLEAN_SESSION
+  _mqtt_clean_session = DEF_MQTT_CLEAN_SESSION;
+#else
+  _mqtt_clean_session = true;
+#endif
+#ifdef DEF_MQTT_KEEPALIVE
+  _mqtt_keepalive = DEF_MQTT_KEEPALIVE;
+#else
+  _mqtt_keepalive = 15;
+#endif
+#ifdef DEF_HTTP_URL
+  allocStr_P(&_http_url, PSTR(DEF_HTTP_URL));
+#else
+  disposeStr(&_http_url);
+#endif
+#ifdef DEF_UDP_SERVER
+  allocStr_P(&_udp_server, PSTR(DEF_UDP_SERVER));
+#else
+  disposeStr(&_udp_server);
+#endif
+#ifdef DEF_HTTP_BATCH
+  _http_batch = DEF_HTTP_BATCH;
+#else
+  _http_batch = 1;
+#endif
+#ifdef DEF_UDP_PORT
+  _udp_port = DEF_UDP_PORT;
+#else
+  _udp_port = 5000;
+#endif
+#ifdef DEF_UDP_ACK
+  _udp_ack = DEF_UDP_ACK;
+#else
+  _udp_ack = false;
+#endif
+#ifdef DEF_BARCODE_TRANSFORM
+  allocStr_P(&_barcode_transform, PSTR(DEF_BARCODE_TRANSFORM));
+#else
+  disposeStr(&_barcode_transform);
+#endif
+#ifdef DEF_MQTT_CONFIG_TOPIC
+  allocStr_P(&_mqtt_config_topic, PSTR(DEF_MQTT_CONFIG_TOPIC));
+#else
+  disposeStr(&_mqtt_config_topic);
+#endif
+#ifdef DEF_MQTT_OTA_TOPIC
+  allocStr_P(&_mqtt_ota_topic, PSTR(DEF_MQTT_OTA_TOPIC));
+#else
+  disposeStr(&_mqtt_ota_topic);
+#endif
+  _mqtt_routes.clear();
+  _transform.compile(_barcode_transform);
 }
 
 void Config::read(const JsonDocument &doc) {
@@ -196,6 +527,316 @@ void Config::read(const JsonDocument &doc) {
 #else
     disposeStr(&_mqtt_button_topic);
 #endif
+  if (doc.containsKey(FPSTR(MQTT_STATS_TOPIC_PARAM)))
+    allocStr(&_mqtt_stats_topic, doc[FPSTR(MQTT_STATS_TOPIC_PARAM)].as<const char*>());
+  else
+#ifdef DEF_MQTT_STATS_TOPIC
+    allocStr_P(&_mqtt_stats_topic, PSTR(DEF_MQTT_STATS_TOPIC));
+#else
+    disposeStr(&_mqtt_stats_topic);
+#endif
+  if (doc.containsKey(FPSTR(DEDUP_MODE_PARAM)) && (doc[FPSTR(DEDUP_MODE_PARAM)].as<uint8_t>() <= DEDUP_TOPIC))
+    _dedup_mode = (dedupmode_t)doc[FPSTR(DEDUP_MODE_PARAM)].as<uint8_t>();
+  else
+#ifdef DEF_DEDUP_MODE
+    _dedup_mode = DEF_DEDUP_MODE;
+#else
+    _dedup_mode = DEDUP_OFF;
+#endif
+  if (doc.containsKey(FPSTR(DEDUP_WINDOW_PARAM)))
+    _dedup_window = doc[FPSTR(DEDUP_WINDOW_PARAM)];
+  else
+#ifdef DEF_DEDUP_WINDOW
+    _dedup_window = DEF_DEDUP_WINDOW;
+#else
+    _dedup_window = 0;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_ERROR_TOPIC_PARAM)))
+    allocStr(&_mqtt_error_topic, doc[FPSTR(MQTT_ERROR_TOPIC_PARAM)].as<const char*>());
+  else
+#ifdef DEF_MQTT_ERROR_TOPIC
+    allocStr_P(&_mqtt_error_topic, PSTR(DEF_MQTT_ERROR_TOPIC));
+#else
+    disposeStr(&_mqtt_error_topic);
+#endif
+  if (doc.containsKey(FPSTR(BARCODE_VALIDATE_PARAM)))
+    _barcode_validate = doc[FPSTR(BARCODE_VALIDATE_PARAM)];
+  else
+#ifdef DEF_BARCODE_VALIDATE
+    _barcode_validate = DEF_BARCODE_VALIDATE;
+#else
+    _barcode_validate = false;
+#endif
+  if (doc.containsKey(FPSTR(BARCODE_GUESS_PARAM)))
+    _barcode_guess = doc[FPSTR(BARCODE_GUESS_PARAM)];
+  else
+#ifdef DEF_BARCODE_GUESS
+    _barcode_guess = DEF_BARCODE_GUESS;
+#else
+    _barcode_guess = false;
+#endif
+  if (doc.containsKey(FPSTR(GS1_DECODE_PARAM)) && (doc[FPSTR(GS1_DECODE_PARAM)].as<uint8_t>() <= PAYLOAD_CBOR))
+    _gs1_decode = (payloadformat_t)doc[FPSTR(GS1_DECODE_PARAM)].as<uint8_t>();
+  else
+#ifdef DEF_GS1_DECODE
+    _gs1_decode = DEF_GS1_DECODE;
+#else
+    _gs1_decode = PAYLOAD_RAW;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_BARCODE_FORMAT_PARAM)) && (doc[FPSTR(MQTT_BARCODE_FORMAT_PARAM)].as<uint8_t>() <= PAYLOAD_CBOR))
+    _mqtt_barcode_format = (payloadformat_t)doc[FPSTR(MQTT_BARCODE_FORMAT_PARAM)].as<uint8_t>();
+  else
+#ifdef DEF_MQTT_BARCODE_FORMAT
+    _mqtt_barcode_format = DEF_MQTT_BARCODE_FORMAT;
+#else
+    _mqtt_barcode_format = PAYLOAD_RAW;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_BUTTON_FORMAT_PARAM)) && (doc[FPSTR(MQTT_BUTTON_FORMAT_PARAM)].as<uint8_t>() <= PAYLOAD_CBOR))
+    _mqtt_button_format = (payloadformat_t)doc[FPSTR(MQTT_BUTTON_FORMAT_PARAM)].as<uint8_t>();
+  else
+#ifdef DEF_MQTT_BUTTON_FORMAT
+    _mqtt_button_format = DEF_MQTT_BUTTON_FORMAT;
+#else
+    _mqtt_button_format = PAYLOAD_RAW;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_BARCODE_FIELDS_PARAM)))
+    _mqtt_barcode_fields = doc[FPSTR(MQTT_BARCODE_FIELDS_PARAM)];
+  else
+#ifdef DEF_MQTT_BARCODE_FIELDS
+    _mqtt_barcode_fields = DEF_MQTT_BARCODE_FIELDS;
+#else
+    _mqtt_barcode_fields = 0;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_BUTTON_FIELDS_PARAM)))
+    _mqtt_button_fields = doc[FPSTR(MQTT_BUTTON_FIELDS_PARAM)];
+  else
+#ifdef DEF_MQTT_BUTTON_FIELDS
+    _mqtt_button_fields = DEF_MQTT_BUTTON_FIELDS;
+#else
+    _mqtt_button_fields = 0;
+#endif
+  if (doc.containsKey(FPSTR(LOOKUP_FILE_PARAM)))
+    allocStr(&_lookup_file, doc[FPSTR(LOOKUP_FILE_PARAM)].as<const char*>());
+  else
+#ifdef DEF_LOOKUP_FILE
+    allocStr_P(&_lookup_file, PSTR(DEF_LOOKUP_FILE));
+#else
+    disposeStr(&_lookup_file);
+#endif
+  if (doc.containsKey(FPSTR(GM65_BAUD_PARAM)))
+    _gm65_baud = doc[FPSTR(GM65_BAUD_PARAM)];
+  else
+#ifdef DEF_GM65_BAUD
+    _gm65_baud = DEF_GM65_BAUD;
+#else
+    _gm65_baud = 0;
+#endif
+  if (doc.containsKey(FPSTR(GM65_MODE_PARAM)))
+    _gm65_mode = (gm65mode_t)doc[FPSTR(GM65_MODE_PARAM)].as<uint8_t>();
+  else
+#ifdef DEF_GM65_MODE
+    _gm65_mode = DEF_GM65_MODE;
+#else
+    _gm65_mode = GM65_KEEP;
+#endif
+  if (doc.containsKey(FPSTR(GM65_TAIL_PARAM)))
+    _gm65_tail = (gm65tail_t)doc[FPSTR(GM65_TAIL_PARAM)].as<uint8_t>();
+  else
+#ifdef DEF_GM65_TAIL
+    _gm65_tail = DEF_GM65_TAIL;
+#else
+    _gm65_tail = GM65_TAIL_KEEP;
+#endif
+  if (doc.containsKey(FPSTR(GM65_CODE_ID_PARAM)))
+    _gm65_code_id = doc[FPSTR(GM65_CODE_ID_PARAM)];
+  else
+#ifdef DEF_GM65_CODE_ID
+    _gm65_code_id = DEF_GM65_CODE_ID;
+#else
+    _gm65_code_id = false;
+#endif
+  if (doc.containsKey(FPSTR(GM65_SYMBOLOGIES_PARAM)))
+    _gm65_symbologies = doc[FPSTR(GM65_SYMBOLOGIES_PARAM)];
+  else
+#ifdef DEF_GM65_SYMBOLOGIES
+    _gm65_symbologies = DEF_GM65_SYMBOLOGIES;
+#else
+    _gm65_symbologies = 0;
+#endif
+  if (doc.containsKey(FPSTR(GM65_SAVE_PARAM)))
+    _gm65_save = doc[FPSTR(GM65_SAVE_PARAM)];
+  else
+#ifdef DEF_GM65_SAVE
+    _gm65_save = DEF_GM65_SAVE;
+#else
+    _gm65_save = false;
+#endif
+  if (doc.containsKey(FPSTR(UART_RX_BUFFER_PARAM)) && (doc[FPSTR(UART_RX_BUFFER_PARAM)].as<uint16_t>() >= MIN_UART_RX_BUFFER) &&
+    (doc[FPSTR(UART_RX_BUFFER_PARAM)].as<uint16_t>() <= MAX_UART_RX_BUFFER))
+    _uart_rx_buffer = doc[FPSTR(UART_RX_BUFFER_PARAM)];
+  else
+#ifdef DEF_UART_RX_BUFFER
+    _uart_rx_buffer = DEF_UART_RX_BUFFER;
+#else
+    _uart_rx_buffer = 256;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_LOG_TOPIC_PARAM)))
+    allocStr(&_mqtt_log_topic, doc[FPSTR(MQTT_LOG_TOPIC_PARAM)].as<const char*>());
+  else
+#ifdef DEF_MQTT_LOG_TOPIC
+    allocStr_P(&_mqtt_log_topic, PSTR(DEF_MQTT_LOG_TOPIC));
+#else
+    disposeStr(&_mqtt_log_topic);
+#endif
+  if (doc.containsKey(FPSTR(SYSLOG_SERVER_PARAM)))
+    allocStr(&_syslog_server, doc[FPSTR(SYSLOG_SERVER_PARAM)].as<const char*>());
+  else
+#ifdef DEF_SYSLOG_SERVER
+    allocStr_P(&_syslog_server, PSTR(DEF_SYSLOG_SERVER));
+#else
+    disposeStr(&_syslog_server);
+#endif
+  if (doc.containsKey(FPSTR(SYSLOG_PORT_PARAM)))
+    _syslog_port = doc[FPSTR(SYSLOG_PORT_PARAM)];
+  else
+#ifdef DEF_SYSLOG_PORT
+    _syslog_port = DEF_SYSLOG_PORT;
+#else
+    _syslog_port = 514;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_QOS_PARAM)) && (doc[FPSTR(MQTT_QOS_PARAM)].as<uint8_t>() <= 2))
+    _mqtt_qos = (uint8_t)doc[FPSTR(MQTT_QOS_PARAM)].as<uint8_t>();
+  else
+#ifdef DEF_MQTT_QOS
+    _mqtt_qos = DEF_MQTT_QOS;
+#else
+    _mqtt_qos = 0;
+#endif
+  if (doc.containsKey(FPSTR(NTP_SERVER_PARAM)))
+    allocStr(&_ntp_server, doc[FPSTR(NTP_SERVER_PARAM)].as<const char*>());
+  else
+#ifdef DEF_NTP_SERVER
+    allocStr_P(&_ntp_server, PSTR(DEF_NTP_SERVER));
+#else
+    disposeStr(&_ntp_server);
+#endif
+  if (doc.containsKey(FPSTR(MQTT_SECURE_PARAM)))
+    _mqtt_secure = doc[FPSTR(MQTT_SECURE_PARAM)];
+  else
+#ifdef DEF_MQTT_SECURE
+    _mqtt_secure = DEF_MQTT_SECURE;
+#else
+    _mqtt_secure = false;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_FINGERPRINT_PARAM)))
+    allocStr(&_mqtt_fingerprint, doc[FPSTR(MQTT_FINGERPRINT_PARAM)].as<const char*>());
+  else
+#ifdef DEF_MQTT_FINGERPRINT
+    allocStr_P(&_mqtt_fingerprint, PSTR(DEF_MQTT_FINGERPRINT));
+#else
+    disposeStr(&_mqtt_fingerprint);
+#endif
+  if (doc.containsKey(FPSTR(MQTT_STATUS_TOPIC_PARAM)))
+    allocStr(&_mqtt_status_topic, doc[FPSTR(MQTT_STATUS_TOPIC_PARAM)].as<const char*>());
+  else
+#ifdef DEF_MQTT_STATUS_TOPIC
+    allocStr_P(&_mqtt_status_topic, PSTR(DEF_MQTT_STATUS_TOPIC));
+#else
+    disposeStr(&_mqtt_status_topic);
+#endif
+  if (doc.containsKey(FPSTR(MQTT_CLEAN_SESSION_PARAM)))
+    _mqtt_clean_session = doc[FPSTR(MQTT_CLEAN_SESSION_PARAM)];
+  else
+#ifdef DEF_MQTT_CLEAN_SESSION
+    _mqtt_clean_session = DEF_MQTT_CLEAN_SESSION;
+#else
+    _mqtt_clean_session = true;
+#endif
+  if (doc.containsKey(FPSTR(MQTT_KEEPALIVE_PARAM)))
+    _mqtt_keepalive = doc[FPSTR(MQTT_KEEPALIVE_PARAM)];
+  else
+#ifdef DEF_MQTT_KEEPALIVE
+    _mqtt_keepalive = DEF_MQTT_KEEPALIVE;
+#else
+    _mqtt_keepalive = 15;
+#endif
+  if (doc.containsKey(FPSTR(HTTP_URL_PARAM)))
+    allocStr(&_http_url, doc[FPSTR(HTTP_URL_PARAM)].as<const char*>());
+  else
+#ifdef DEF_HTTP_URL
+    allocStr_P(&_http_url, PSTR(DEF_HTTP_URL));
+#else
+    disposeStr(&_http_url);
+#endif
+  if (doc.containsKey(FPSTR(UDP_SERVER_PARAM)))
+    allocStr(&_udp_server, doc[FPSTR(UDP_SERVER_PARAM)].as<const char*>());
+  else
+#ifdef DEF_UDP_SERVER
+    allocStr_P(&_udp_server, PSTR(DEF_UDP_SERVER));
+#else
+    disposeStr(&_udp_server);
+#endif
+  if (doc.containsKey(FPSTR(HTTP_BATCH_PARAM)))
+    _http_batch = doc[FPSTR(HTTP_BATCH_PARAM)];
+  else
+#ifdef DEF_HTTP_BATCH
+    _http_batch = DEF_HTTP_BATCH;
+#else
+    _http_batch = 1;
+#endif
+  if (doc.containsKey(FPSTR(UDP_PORT_PARAM)))
+    _udp_port = doc[FPSTR(UDP_PORT_PARAM)];
+  else
+#ifdef DEF_UDP_PORT
+    _udp_port = DEF_UDP_PORT;
+#else
+    _udp_port = 5000;
+#endif
+  if (doc.containsKey(FPSTR(UDP_ACK_PARAM)))
+    _udp_ack = doc[FPSTR(UDP_ACK_PARAM)];
+  else
+#ifdef DEF_UDP_ACK
+    _udp_ack = DEF_UDP_ACK;
+#else
+    _udp_ack = false;
+#endif
+  if (doc.containsKey(FPSTR(BARCODE_TRANSFORM_PARAM)))
+    allocStr(&_barcode_transform, doc[FPSTR(BARCODE_TRANSFORM_PARAM)].as<const char*>());
+  else
+#ifdef DEF_BARCODE_TRANSFORM
+    allocStr_P(&_barcode_transform, PSTR(DEF_BARCODE_TRANSFORM));
+#else
+    disposeStr(&_barcode_transform);
+#endif
+  if (doc.containsKey(FPSTR(MQTT_CONFIG_TOPIC_PARAM)))
+    allocStr(&_mqtt_config_topic, doc[FPSTR(MQTT_CONFIG_TOPIC_PARAM)].as<const char*>());
+  else
+#ifdef DEF_MQTT_CONFIG_TOPIC
+    allocStr_P(&_mqtt_config_topic, PSTR(DEF_MQTT_CONFIG_TOPIC));
+#else
+    disposeStr(&_mqtt_config_topic);
+#endif
+  if (doc.containsKey(FPSTR(MQTT_OTA_TOPIC_PARAM)))
+    allocStr(&_mqtt_ota_topic, doc[FPSTR(MQTT_OTA_TOPIC_PARAM)].as<const char*>());
+  else
+#ifdef DEF_MQTT_OTA_TOPIC
+    allocStr_P(&_mqtt_ota_topic, PSTR(DEF_MQTT_OTA_TOPIC));
+#else
+    disposeStr(&_mqtt_ota_topic);
+#endif
+  _mqtt_routes.clear();
+  if (doc.containsKey(FPSTR(MQTT_ROUTES_PARAM))) {
+    uint8_t skipped = _mqtt_routes.read(doc[FPSTR(MQTT_ROUTES_PARAM)].as<JsonArrayConst>());
+
+    if (skipped)
+      LOG_E("%u wrong route(s) skipped!", skipped);
+  }
+  if (! _mqtt_routes.compile(_mqtt_client)) { // Templates are expanded once here, not per scan
+    LOG_E("Wrong routes!");
+    _mqtt_routes.clear(); // Partially built trie must not route
+  }
+  if (! _transform.compile(_barcode_transform))
+    LOG_E("Wrong barcode transform!");
 }
 
 void Config::write(JsonDocument &doc) {
@@ -212,6 +853,45 @@ void Config::write(JsonDocument &doc) {
   doc[FPSTR(MQTT_RETAINED_PARAM)] = _mqtt_retained;
   doc[FPSTR(MQTT_BARCODE_TOPIC_PARAM)] = _mqtt_barcode_topic ? _mqtt_barcode_topic : EMPTY_STR;
   doc[FPSTR(MQTT_BUTTON_TOPIC_PARAM)] = _mqtt_button_topic ? _mqtt_button_topic : EMPTY_STR;
+  doc[FPSTR(MQTT_STATS_TOPIC_PARAM)] = _mqtt_stats_topic ? _mqtt_stats_topic : EMPTY_STR;
+  doc[FPSTR(DEDUP_MODE_PARAM)] = (uint8_t)_dedup_mode;
+  doc[FPSTR(DEDUP_WINDOW_PARAM)] = _dedup_window;
+  doc[FPSTR(MQTT_ERROR_TOPIC_PARAM)] = _mqtt_error_topic ? _mqtt_error_topic : EMPTY_STR;
+  doc[FPSTR(BARCODE_VALIDATE_PARAM)] = _barcode_validate;
+  doc[FPSTR(BARCODE_GUESS_PARAM)] = _barcode_guess;
+  doc[FPSTR(GS1_DECODE_PARAM)] = (uint8_t)_gs1_decode;
+  doc[FPSTR(MQTT_BARCODE_FORMAT_PARAM)] = (uint8_t)_mqtt_barcode_format;
+  doc[FPSTR(MQTT_BUTTON_FORMAT_PARAM)] = (uint8_t)_mqtt_button_format;
+  doc[FPSTR(MQTT_BARCODE_FIELDS_PARAM)] = _mqtt_barcode_fields;
+  doc[FPSTR(MQTT_BUTTON_FIELDS_PARAM)] = _mqtt_button_fields;
+  doc[FPSTR(LOOKUP_FILE_PARAM)] = _lookup_file ? _lookup_file : EMPTY_STR;
+  doc[FPSTR(GM65_BAUD_PARAM)] = _gm65_baud;
+  doc[FPSTR(GM65_MODE_PARAM)] = (uint8_t)_gm65_mode;
+  doc[FPSTR(GM65_TAIL_PARAM)] = (uint8_t)_gm65_tail;
+  doc[FPSTR(GM65_CODE_ID_PARAM)] = _gm65_code_id;
+  doc[FPSTR(GM65_SYMBOLOGIES_PARAM)] = _gm65_symbologies;
+  doc[FPSTR(GM65_SAVE_PARAM)] = _gm65_save;
+  doc[FPSTR(UART_RX_BUFFER_PARAM)] = _uart_rx_buffer;
+  doc[FPSTR(MQTT_LOG_TOPIC_PARAM)] = _mqtt_log_topic ? _mqtt_log_topic : EMPTY_STR;
+  doc[FPSTR(SYSLOG_SERVER_PARAM)] = _syslog_server ? _syslog_server : EMPTY_STR;
+  doc[FPSTR(SYSLOG_PORT_PARAM)] = _syslog_port;
+  doc[FPSTR(MQTT_QOS_PARAM)] = (uint8_t)_mqtt_qos;
+  doc[FPSTR(NTP_SERVER_PARAM)] = _ntp_server ? _ntp_server : EMPTY_STR;
+  doc[FPSTR(MQTT_SECURE_PARAM)] = _mqtt_secure;
+  doc[FPSTR(MQTT_FINGERPRINT_PARAM)] = _mqtt_fingerprint ? _mqtt_fingerprint : EMPTY_STR;
+  doc[FPSTR(MQTT_STATUS_TOPIC_PARAM)] = _mqtt_status_topic ? _mqtt_status_topic : EMPTY_STR;
+  doc[FPSTR(MQTT_CLEAN_SESSION_PARAM)] = _mqtt_clean_session;
+  doc[FPSTR(MQTT_KEEPALIVE_PARAM)] = _mqtt_keepalive;
+  doc[FPSTR(HTTP_URL_PARAM)] = _http_url ? _http_url : EMPTY_STR;
+  doc[FPSTR(UDP_SERVER_PARAM)] = _udp_server ? _udp_server : EMPTY_STR;
+  doc[FPSTR(HTTP_BATCH_PARAM)] = _http_batch;
+  doc[FPSTR(UDP_PORT_PARAM)] = _udp_port;
+  doc[FPSTR(UDP_ACK_PARAM)] = _udp_ack;
+  doc[FPSTR(BARCODE_TRANSFORM_PARAM)] = _barcode_transform ? _barcode_transform : EMPTY_STR;
+  doc[FPSTR(MQTT_CONFIG_TOPIC_PARAM)] = _mqtt_config_topic ? _mqtt_config_topic : EMPTY_STR;
+  doc[FPSTR(MQTT_OTA_TOPIC_PARAM)] = _mqtt_ota_topic ? _mqtt_ota_topic : EMPTY_STR;
+
+  _mqtt_routes.write(doc.createNestedArray(FPSTR(MQTT_ROUTES_PARAM)));
 }
 
 void Config::genMqttClient() {
@@ -233,20 +913,73 @@ WiFiEventHandler wifiConnectHandler;
 AsyncMqttClient *mqtt = NULL;
 volatile uint32_t wifiLastConnecting = 0;
 volatile uint32_t mqttLastConnecting = 0;
+uint32_t mqttConnectTime = 0; // Last connect (TCP + TLS + CONNACK) duration, ms
+uint32_t heapMin = 0xFFFFFFFF;
+uint32_t mqttDisconnects = 0;
+uint32_t mqttResumes = 0; // Connects with session present
+
+char *configPatch = NULL; // Received in MQTT callback, applied in loop
+volatile uint16_t configPatchLen = 0;
+volatile bool configPatchReady = false;
+uint32_t restartTime = 0; // Delayed restart after saving cold parameters
+uint32_t reconnectTime = 0; // Delayed reconnect after applying WiFi or MQTT parameters
+uint8_t reconnectActions;
+MqttOta ota;
+
+static const char OTA_BEGIN[] PROGMEM = "begin";
+static const char OTA_DATA[] PROGMEM = "data";
+static const char OTA_ABORT[] PROGMEM = "abort";
+static const char OTA_ACK[] PROGMEM = "ack";
+
+static const char STATUS_ONLINE[] = "online";
+static const char STATUS_OFFLINE[] = "offline";
 EventQueue *events;
+#ifdef ONE_BUTTON
 Button *btn;
+#else
+Buttons *btn;
+char *buttonTopics[BTN_COUNT + 1]; // Topic per button, last one for chords
+#endif
 Led *led;
+Dedup *dedup;
+Lookup *lookup = NULL;
 char barcode[BARCODE_SIZE + 1];
+char barcodeTerminator = BARCODE_TERMINATOR; // '\0' - no terminator, frame by BARCODE_GAP
+uint32_t barcodeTime; // Last byte of current frame
+bool barcodeCorrupt = false; // Frame lost bytes with RX overrun, dropped up to next terminator
+uint32_t invalidBarcodes = 0;
+uint32_t rxOverruns = 0;
+uint32_t rxErrors = 0;
+uint32_t barcodeSeq = 0;
+uint32_t buttonSeq = 0;
+Tracer tracer;
+CaptivePortal *portal = NULL; // Concurrent portal opened by long click
+Histogram loopTime; // Loop pass without idle wait
+Histogram portalTime; // Portal share of loop pass
+Dispatcher dispatcher;
+HttpSink *httpSink = NULL;
+UdpSink *udpSink = NULL;
+
+const uint8_t BUTTON_STATES = 3; // Click, long click, double click
+
+struct __packed buttonpayload_t {
+  uint8_t len; // 0 if payload has to be encoded per click
+  char data[63];
+} buttonPayloads[BUTTON_STATES];
+
+class MqttLogSink : public LogSink {
+public:
+  void write(loglevel_t level, const char *line, uint8_t len) {
+    if (mqtt && mqtt->connected() && config->_mqtt_log_topic) // Not through mqttPublishTopic(), it logs itself
+      mqtt->publish(config->_mqtt_log_topic, 0, false, line, len);
+  }
+};
 
 static void wifiConnect() {
   const uint32_t WIFI_CONNECT_TIMEOUT = 60000; // 60 sec.
 
   if ((! wifiLastConnecting) || (millis() - wifiLastConnecting >= WIFI_CONNECT_TIMEOUT)) {
-#ifdef USE_SERIAL
-    Serial.print(F("Connecting to SSID \""));
-    Serial.print(config->_wifi_ssid);
-    Serial.println(F("\"..."));
-#endif
+    LOG_I("Connecting to SSID \"%s\"...", config->_wifi_ssid);
     WiFi.disconnect();
     WiFi.begin(config->_wifi_ssid, config->_wifi_pswd);
     wifiLastConnecting = millis();
@@ -258,13 +991,7 @@ static void mqttConnect() {
   const uint32_t MQTT_CONNECT_TIMEOUT = 60000; // 60 sec.
 
   if ((! mqttLastConnecting) || (millis() - mqttLastConnecting >= MQTT_CONNECT_TIMEOUT)) {
-#ifdef USE_SERIAL
-    Serial.print(F("Connecting to MQTT broker \""));
-    Serial.print(config->_mqtt_server);
-    Serial.print(':');
-    Serial.print(config->_mqtt_port);
-    Serial.println(F("\"..."));
-#endif
+    LOG_I("Connecting to MQTT broker \"%s:%u\"...", config->_mqtt_server, config->_mqtt_port);
     mqtt->disconnect();
     mqtt->connect();
     mqttLastConnecting = millis();
@@ -272,104 +999,750 @@ static void mqttConnect() {
   }
 }
 
+static void mqttSettings() { // Client keeps pointers to config strings
+  mqtt->setServer(config->_mqtt_server, config->_mqtt_port);
+  mqtt->setClientId(config->_mqtt_client);
+  mqtt->setCredentials(config->_mqtt_user, config->_mqtt_pswd);
+  mqtt->setCleanSession(config->_mqtt_clean_session);
+  mqtt->setKeepAlive(config->_mqtt_keepalive);
+  mqtt->setWill(config->_mqtt_status_topic, 1, true, STATUS_OFFLINE, sizeof(STATUS_OFFLINE) - 1);
+}
+
 static void onWifiConnect(const WiFiEventStationModeGotIP &event) {
-#ifdef USE_SERIAL
-  Serial.print(F("Connected to WiFi (IP: "));
-  Serial.print(event.ip);
-  Serial.println(')');
-#endif
+  LOG_I("Connected to WiFi (IP: %s)", event.ip.toString().c_str());
   wifiLastConnecting = 0;
   led->setMode(LED_FADEOUT);
   if (mqtt)
     mqttConnect();
 }
 
+static void mqttOtaTopic(char *topic, uint8_t size, PGM_P suffix) {
+  snprintf_P(topic, size, PSTR("%s/%S"), config->_mqtt_ota_topic, suffix);
+}
+
+static void mqttOtaAck() {
+  char topic[Router::TOPIC_SIZE];
+  char value[96];
+
+  mqttOtaTopic(topic, sizeof(topic), OTA_ACK);
+  mqtt->publish(topic, 1, false, value, ota.status(value, sizeof(value)));
+}
+
 static void onMqttConnect(bool sessionPresent) {
-#ifdef USE_SERIAL
-  Serial.println(F("Connected to MQTT broker"));
-#endif
+  mqttConnectTime = millis() - mqttLastConnecting;
+  LOG_I("Connected to MQTT broker in %u ms%S", mqttConnectTime, sessionPresent ? PSTR(" (session resumed)") : PSTR(""));
   mqttLastConnecting = 0;
+  if (sessionPresent)
+    ++mqttResumes;
+  else
+    tracer.clear(); // Broker dropped the session, pending acks will never come
+  if (config->_mqtt_status_topic) // Birth message, will replaces it on unexpected disconnect
+    mqtt->publish(config->_mqtt_status_topic, 1, true, STATUS_ONLINE, sizeof(STATUS_ONLINE) - 1);
+  if (config->_mqtt_config_topic)
+    mqtt->subscribe(config->_mqtt_config_topic, 1);
+  if (config->_mqtt_ota_topic) {
+    char topic[Router::TOPIC_SIZE];
+
+    mqttOtaTopic(topic, sizeof(topic), OTA_BEGIN);
+    mqtt->subscribe(topic, 1);
+    mqttOtaTopic(topic, sizeof(topic), OTA_DATA);
+    mqtt->subscribe(topic, 1);
+    mqttOtaTopic(topic, sizeof(topic), OTA_ABORT);
+    mqtt->subscribe(topic, 1);
+    if (ota.state() == OTA_RUNNING) // Tell sender where to resume
+      mqttOtaAck();
+  }
   led->setMode(LED_FADEINOUT);
 }
 
-static bool mqttPublishTopic(const char *topic, const char *value) {
+static void onMqttDisconnect(AsyncMqttClientDisconnectReason reason) {
+  ++mqttDisconnects;
+  LOG_W("Disconnected from MQTT broker (reason %u)", (uint8_t)reason);
+}
+
+static void onMqttPublish(uint16_t packetId) {
+  tracer.ack(packetId);
+}
+
+static void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total) {
+  const uint16_t PATCH_SIZE = 1024;
+
+  if (config->_mqtt_ota_topic) {
+    size_t prefix = strlen(config->_mqtt_ota_topic);
+
+    if ((! strncmp(topic, config->_mqtt_ota_topic, prefix)) && (topic[prefix] == '/')) { // Image is written right from callback
+      const char *suffix = &topic[prefix + 1];
+      bool ack = false;
+
+      if (! strcmp_P(suffix, OTA_DATA)) {
+        ack = ota.write((uint8_t*)payload, len, index, total);
+      } else if (! strcmp_P(suffix, OTA_BEGIN)) {
+        if ((! index) && (len == total))
+          ack = ota.begin(payload, len);
+      } else if (! strcmp_P(suffix, OTA_ABORT)) {
+        ota.abort();
+        ack = true;
+      }
+      if (ack)
+        mqttOtaAck();
+      return;
+    }
+  }
+  if (configPatchReady || (total > PATCH_SIZE) || (! config->_mqtt_config_topic) || strcmp(topic, config->_mqtt_config_topic))
+    return;
+  if (! index) {
+    if (! configPatch)
+      configPatch = (char*)malloc(PATCH_SIZE);
+    configPatchLen = 0;
+  }
+  if ((! configPatch) || (index != configPatchLen)) // Lost fragment
+    return;
+  memcpy(&configPatch[index], payload, len);
+  configPatchLen += len;
+  if (configPatchLen == total)
+    configPatchReady = true;
+}
+
+static uint16_t mqttPublishTopic(const char *topic, const char *value, uint16_t len) { // Returns packet id, 0 on error
   if (mqtt->connected()) {
-#ifdef USE_SERIAL
-    Serial.print(F("Publish MQTT topic \""));
-    Serial.print(topic);
-    Serial.print(F("\" with value \""));
-    Serial.print(value);
-    Serial.println('"');
-#endif
+    LOG_D("Publish MQTT topic \"%s\" with %u byte(s) value", topic, len);
 
-    return mqtt->publish(topic, MQTT_QOS, config->_mqtt_retained, value, 0) != 0;
+    return mqtt->publish(topic, config->_mqtt_qos, config->_mqtt_retained, value, len);
   }
 
-  return false;
+  return 0;
 }
 
-static bool mqttPublishBarcode(const char *barcode) {
-  if (mqtt && config->_mqtt_barcode_topic) {
-    return mqttPublishTopic(config->_mqtt_barcode_topic, barcode);
+class MqttSink : public OutputSink {
+public:
+  bool ready() {
+    return mqtt->connected();
+  }
+  bool send(const char *topic, const char *payload, uint16_t len, uint64_t framed) {
+    if (! *topic) // No barcode topic, other sinks only
+      return true;
+
+    uint16_t packetId = mqttPublishTopic(topic, payload, len);
+
+    if (packetId)
+      tracer.handoff(framed, config->_mqtt_qos ? packetId : 0);
+
+    return packetId != 0;
+  }
+};
+
+static bool publishBarcode(const char *topic, uint64_t framed, const char *payload, uint16_t len) {
+  return dispatcher.publish(topic ? topic : "", payload, len, framed) != 0;
+}
+
+static const char SEQ_KEY[] PROGMEM = "seq";
+static const char TIME_KEY[] PROGMEM = "time";
+static const char SYMBOLOGY_KEY[] PROGMEM = "symbology";
+static const char CLIENT_KEY[] PROGMEM = "client";
+static const char FRAMED_KEY[] PROGMEM = "framed";
+static const char CODE_KEY[] PROGMEM = "code";
+static const char GS1_KEY[] PROGMEM = "gs1";
+static const char INFO_KEY[] PROGMEM = "info";
+static const char BUTTON_KEY[] PROGMEM = "button";
+static const char CLICKS_KEY[] PROGMEM = "clicks";
+static const char CHORD_KEY[] PROGMEM = "chord";
+
+static void encodeMeta(PayloadWriter &writer, uint8_t fields, uint32_t seq, symbology_t symbology = SYM_UNKNOWN, uint64_t framed = 0) {
+  if (fields & PAYLOAD_SEQ)
+    writer.add(SEQ_KEY, seq);
+  if (fields & PAYLOAD_TIME)
+    writer.add(TIME_KEY, sysClock.now()); // Epoch ms after SNTP sync, uptime ms before
+  if (fields & PAYLOAD_SYMBOLOGY) {
+    PGM_P name = symbologyName(symbology);
+
+    writer.add(SYMBOLOGY_KEY, name, strlen_P(name), true);
+  }
+  if ((fields & PAYLOAD_CLIENT) && config->_mqtt_client)
+    writer.add(CLIENT_KEY, config->_mqtt_client, strlen(config->_mqtt_client));
+  if ((fields & PAYLOAD_TRACE) && framed)
+    writer.add(FRAMED_KEY, sysClock.toWall(framed));
+}
+
+static bool mqttPublishInvalid(const char *barcode, uint8_t len) {
+  if (mqtt && config->_mqtt_error_topic) {
+    return mqttPublishTopic(config->_mqtt_error_topic, barcode, len);
   }
 
   return false;
 }
 
-static bool mqttPublishButton(btneventid_t state) {
+static void processBarcode(const char *barcode, uint8_t len, bool cutted, uint64_t framed) {
+  if (cutted)
+    LOG_W("Barcode (cutted): \"%s\"", barcode);
+  else
+    LOG_I("Barcode: \"%s\"", barcode);
+
+  barcodeinfo_t info;
+  bool valid = (! cutted) && classifyBarcode(barcode, len, &info,
+    (config->_barcode_guess ? CLASSIFY_GUESS : 0) | (config->_gm65_code_id ? CLASSIFY_CODE_ID : 0));
+
+  if (config->_barcode_validate) {
+    if (! valid) {
+      ++invalidBarcodes;
+      LOG_W("Invalid barcode!");
+      mqttPublishInvalid(barcode, len);
+
+      return;
+    }
+    LOG_D("Symbology: %S", symbologyName(info.symbology));
+  }
+
+  char routed[Router::TOPIC_SIZE];
+  const char *topic;
+
+  if (valid)
+    topic = config->_mqtt_routes.route(&barcode[info.offset], info.length, info.symbology, routed);
+  else
+    topic = config->_mqtt_routes.route(barcode, len, SYM_UNKNOWN, routed);
+  if (! topic)
+    topic = config->_mqtt_barcode_topic;
+  if (dedup->isDuplicate(barcode, len, topic)) {
+    LOG_D("Duplicate barcode suppressed");
+
+    return;
+  }
+
+  bool gs1 = config->_gs1_decode && valid &&
+    ((info.symbology == SYM_GS1_128) || (info.symbology == SYM_GS1_DATAMATRIX) || (barcode[info.offset] == GS1_FNC1));
+  char payload[PAYLOAD_SIZE];
+  const char *data = barcode;
+  uint16_t size = len;
+
+  ++barcodeSeq;
+  if (config->_mqtt_barcode_format != PAYLOAD_RAW) {
+    PayloadWriter writer(payload, sizeof(payload), config->_mqtt_barcode_format);
+
+    writer.beginMap();
+    encodeMeta(writer, config->_mqtt_barcode_fields, barcodeSeq, valid ? info.symbology : SYM_UNKNOWN, framed);
+    writer.add(CODE_KEY, barcode, len);
+    if (lookup) {
+      char value[256];
+
+      if (valid ? lookup->find(&barcode[info.offset], info.length, value) : lookup->find(barcode, len, value))
+        writer.add(INFO_KEY, value, strlen(value));
+    }
+    if (gs1) {
+      PayloadWriter saved = writer;
+
+      writer.beginMap(GS1_KEY);
+      if (decodeGS1(&barcode[info.offset], info.length, writer))
+        writer.endMap();
+      else
+        writer = saved; // Rollback partially decoded map
+    }
+    writer.endMap();
+    if (! writer.overflow()) {
+      data = payload;
+      size = writer.length();
+    }
+  } else if (gs1) {
+    PayloadWriter writer(payload, sizeof(payload), config->_gs1_decode);
+
+    writer.beginMap();
+    if (decodeGS1(&barcode[info.offset], info.length, writer)) {
+      writer.endMap();
+      if (! writer.overflow()) {
+        data = payload;
+        size = writer.length();
+      }
+    }
+  }
+  if (publishBarcode(topic, framed, data, size))
+    dedup->remember(barcode, len, topic); // Failed publish must not suppress rescan
+}
+
+static uint8_t encodeButton(char *payload, uint8_t size, uint8_t button, uint8_t clicks = 0, PGM_P key = BUTTON_KEY) {
+  PayloadWriter writer(payload, size, config->_mqtt_button_format);
+
+  writer.beginMap();
+  encodeMeta(writer, config->_mqtt_button_fields, buttonSeq);
+  writer.add(key, button);
+  if (clicks)
+    writer.add(CLICKS_KEY, clicks);
+  writer.endMap();
+
+  return writer.overflow() ? 0 : writer.length();
+}
+
+static void prepareButtonPayloads() {
+  for (uint8_t i = 0; i < BUTTON_STATES; ++i) {
+    if (config->_mqtt_button_format == PAYLOAD_RAW) {
+      buttonPayloads[i].data[0] = '1' + i;
+      buttonPayloads[i].len = 1;
+    } else if (! (config->_mqtt_button_fields & (PAYLOAD_SEQ | PAYLOAD_TIME))) // Nothing changes between clicks
+      buttonPayloads[i].len = encodeButton(buttonPayloads[i].data, sizeof(buttonPayloads[i].data), i + 1);
+    else
+      buttonPayloads[i].len = 0;
+  }
+}
+
+#ifndef ONE_BUTTON
+static void prepareButtonTopics() {
+  for (uint8_t i = 0; i <= BTN_COUNT; ++i) {
+    disposeStr(&buttonTopics[i]);
+    if (config->_mqtt_button_topic) {
+      char topic[Router::TOPIC_SIZE];
+
+      if (i < BTN_COUNT)
+        snprintf_P(topic, sizeof(topic), PSTR("%s/%u"), config->_mqtt_button_topic, i + 1);
+      else
+        snprintf_P(topic, sizeof(topic), PSTR("%s/chord"), config->_mqtt_button_topic);
+      allocStr(&buttonTopics[i], topic);
+    }
+  }
+}
+#endif
+
+static bool mqttPublishButton(btneventid_t state, uint8_t data = 0) {
   if (mqtt && config->_mqtt_button_topic) {
-    char value[2];
+    const char *topic;
+    uint8_t button;
+    uint8_t clicks = 0;
 
+#ifdef ONE_BUTTON
+    topic = config->_mqtt_button_topic;
+    if (state == EVT_BTNMULTICLICK)
+      clicks = data;
+#else
+    if (state == EVT_BTNCHORD) {
+      char payload[64];
+      uint8_t len;
+
+      ++buttonSeq;
+      if (config->_mqtt_button_format != PAYLOAD_RAW)
+        len = encodeButton(payload, sizeof(payload), data, 0, CHORD_KEY);
+      else
+        len = 0;
+      if (! len)
+        len = strlen(utoa(data, payload, 10)); // Mask of buttons
+
+      return mqttPublishTopic(buttonTopics[BTN_COUNT], payload, len);
+    }
+    topic = buttonTopics[data & 0x0F];
+    if (state == EVT_BTNMULTICLICK)
+      clicks = data >> 4;
+#endif
     if (state == EVT_BTNCLICK)
-      value[0] = '1';
+      button = 1;
     else if (state == EVT_BTNLONGCLICK)
-      value[0] = '2';
+      button = 2;
     else if (state == EVT_BTNDBLCLICK)
-      value[0] = '3';
-    value[1] = '\0';
+      button = 3;
+    else
+      button = 4; // Multi click, count goes to JSON/CBOR payload only
+
+    ++buttonSeq;
+    if ((button <= BUTTON_STATES) && buttonPayloads[button - 1].len)
+      return mqttPublishTopic(topic, buttonPayloads[button - 1].data, buttonPayloads[button - 1].len);
+    if (config->_mqtt_button_format != PAYLOAD_RAW) {
+      char payload[64];
+      uint8_t len = encodeButton(payload, sizeof(payload), button, clicks);
+
+      if (len)
+        return mqttPublishTopic(topic, payload, len);
+    }
 
-    return mqttPublishTopic(config->_mqtt_button_topic, value);
+    char value = '0' + button;
+
+    return mqttPublishTopic(topic, &value, 1);
   }
 
   return false;
 }
 
+static void addHistogram(JsonArray buckets, const Histogram &histogram) {
+  for (uint8_t i = 0; i < Histogram::BUCKETS; ++i)
+    buckets.add(histogram[i]);
+}
+
+static void fillStats(JsonDocument &doc) {
+  doc[F("uptime")] = millis() / 1000;
+  doc[F("suppressed")] = dedup->suppressed();
+  doc[F("invalid")] = invalidBarcodes;
+  doc[F("rx_overruns")] = rxOverruns;
+  doc[F("rx_errors")] = rxErrors;
+  doc[F("log_dropped")] = logger.dropped();
+  doc[F("btn_edges_lost")] = btn->edgesLost();
+  doc[F("mqtt_connect_ms")] = mqttConnectTime;
+  doc[F("heap_min")] = heapMin;
+  doc[F("mqtt_disconnects")] = mqttDisconnects;
+  doc[F("mqtt_resumes")] = mqttResumes;
+  {
+    JsonArray dropped = doc.createNestedArray(F("sink_dropped"));
+
+    for (uint8_t i = 0; i < dispatcher.sinks(); ++i)
+      dropped.add(dispatcher.dropped(i));
+  }
+  if (httpSink)
+    doc[F("http_errors")] = httpSink->errors();
+  if (udpSink) {
+    doc[F("udp_retries")] = udpSink->retries();
+    doc[F("udp_lost")] = udpSink->lost();
+  }
+  doc[F("time_synced")] = sysClock.synced();
+  doc[F("clock_drift")] = sysClock.drift();
+  addHistogram(doc.createNestedArray(F("lat_publish")), tracer.publish()); // us buckets: <128, <256, ... <2^21, rest
+  addHistogram(doc.createNestedArray(F("lat_ack")), tracer.acked());
+  addHistogram(doc.createNestedArray(F("lat_loop")), loopTime);
+  addHistogram(doc.createNestedArray(F("lat_portal")), portalTime);
+  doc[F("portal")] = portal != NULL;
+  doc[F("ack_lost")] = tracer.lost();
+}
+
+static bool mqttPublishStats() {
+  if (mqtt && config->_mqtt_stats_topic) {
+    DynamicJsonDocument doc(2048); // Histograms take 16 slots each
+
+    fillStats(doc);
+    if (doc.overflowed()) {
+      LOG_E("Stats do not fit JSON document!");
+      return false;
+    }
+
+    size_t len = measureJson(doc); // Grows with counters
+    char *value = (char*)malloc(len + 1);
+    bool result;
+
+    if (! value)
+      return false;
+    result = mqttPublishTopic(config->_mqtt_stats_topic, value, serializeJson(doc, value, len + 1));
+    free(value);
+
+    return result;
+  }
+
+  return false;
+}
+
+static void frameBarcode(uint8_t len, bool cutted) {
+  uint64_t framed = Clock::monotonic();
+
+  len = config->_transform.apply(barcode, len); // In place, classification sees transformed code
+  if (len)
+    processBarcode(barcode, len, cutted, framed);
+}
+
+static void dropBarcode() {
+  LOG_W("Corrupted barcode dropped!");
+  barcodeCorrupt = false;
+}
+
+static void readBarcodes() {
+  int16_t intact = -1; // Bytes received before RX overrun
+
+  if (Serial.hasOverrun()) { // Newest bytes were lost, buffered ones are still intact
+    ++rxOverruns;
+    intact = Serial.available();
+    LOG_W("UART RX overrun!");
+  }
+  if (Serial.hasRxError())
+    ++rxErrors;
+  if (Serial.available()) {
+    uint8_t codelen = strlen(barcode);
+
+    while (Serial.available()) {
+      if (intact > 0) {
+        --intact;
+      } else if (! intact) { // Frame in progress continues after lost bytes
+        barcodeCorrupt = true;
+        intact = -1;
+      }
+
+      char ch = Serial.read();
+
+      if ((ch == barcodeTerminator) || ((ch == '\n') && (barcodeTerminator == '\r'))) { // Empty frame after CR LF is skipped
+        if (barcodeCorrupt)
+          dropBarcode();
+        else if (codelen)
+          frameBarcode(codelen, false);
+        barcode[0] = '\0';
+        codelen = 0;
+      } else if (! barcodeCorrupt) {
+        barcode[codelen++] = ch;
+        barcode[codelen] = '\0';
+        if (codelen >= BARCODE_SIZE) {
+          frameBarcode(codelen, true);
+          barcode[0] = '\0';
+          codelen = 0;
+        }
+      }
+    }
+    barcodeTime = millis();
+  } else if ((! barcodeTerminator) && (barcode[0] || barcodeCorrupt) && (millis() - barcodeTime >= BARCODE_GAP)) {
+    if (barcodeCorrupt)
+      dropBarcode();
+    else
+      frameBarcode(strlen(barcode), false);
+    barcode[0] = '\0';
+  }
+  if (! intact) { // Overrun right after last intact byte
+    barcodeCorrupt = true;
+    barcode[0] = '\0';
+  }
+}
+
+static void waitBarcodes(uint32_t ms) {
+  uint32_t start = millis();
+
+  while ((millis() - start < ms) && (! Serial.available())) { // Wake up as soon as scanner data arrive
+    led->update();
+    delay(0);
+  }
+}
+
 static void halt(const __FlashStringHelper *msg) {
+  LOG_E("%S", (PGM_P)msg);
+  LOG_E("System halted!");
+  logger.flush();
 #ifdef USE_SERIAL
-  Serial.println();
-  Serial.println(msg);
-  Serial.println(F("System halted!"));
   Serial.flush();
 #endif
   ESP.deepSleep(0);
 }
 
 static void restart() {
+  LOG_I("System restarted");
+  logger.flush();
 #ifdef USE_SERIAL
-  Serial.println();
-  Serial.println(F("System restarted"));
   Serial.flush();
 #endif
   ESP.restart();
 }
 
+static void togglePortal() {
+  if (portal) {
+    delete portal; // Closes AP
+    portal = NULL;
+    LOG_I("Captive portal closed");
+  } else {
+    portal = new CaptivePortal(config, led);
+    portal->onMetrics(fillStats);
+    if (portal->begin(true)) {
+      LOG_I("Captive portal opened");
+    } else {
+      LOG_E("Captive portal start error!");
+      delete portal;
+      portal = NULL;
+    }
+  }
+}
+
+static void openLookup() {
+  if (lookup) {
+    delete lookup;
+    lookup = NULL;
+  }
+  if (config->_lookup_file) {
+    lookup = new Lookup();
+    if (lookup->begin(config->_lookup_file)) {
+      LOG_I("Lookup index with %u record(s) opened", lookup->count());
+    } else {
+      LOG_E("Lookup index open error!");
+      delete lookup;
+      lookup = NULL;
+    }
+  }
+}
+
+const uint8_t APPLY_WIFI = 0x01;
+const uint8_t APPLY_MQTT = 0x02;
+const uint8_t APPLY_BUTTONS = 0x04;
+const uint8_t APPLY_DEDUP = 0x08;
+const uint8_t APPLY_LOOKUP = 0x10;
+const uint8_t APPLY_RESTART = 0x80;
+
+struct _hotparam_t {
+  PGM_P name;
+  uint8_t actions; // 0 if nothing caches the parameter
+};
+
+static const _hotparam_t HOT_PARAMS[] PROGMEM = { // Parameters not listed here need restart
+  { WIFI_SSID_PARAM, APPLY_WIFI },
+  { WIFI_PSWD_PARAM, APPLY_WIFI },
+  { MQTT_SERVER_PARAM, APPLY_MQTT },
+  { MQTT_PORT_PARAM, APPLY_MQTT },
+  { MQTT_USER_PARAM, APPLY_MQTT },
+  { MQTT_PSWD_PARAM, APPLY_MQTT },
+  { MQTT_CLEAN_SESSION_PARAM, APPLY_MQTT },
+  { MQTT_KEEPALIVE_PARAM, APPLY_MQTT },
+  { MQTT_STATUS_TOPIC_PARAM, APPLY_MQTT },
+  { MQTT_CONFIG_TOPIC_PARAM, APPLY_MQTT },
+  { MQTT_RETAINED_PARAM, 0 },
+  { MQTT_QOS_PARAM, 0 },
+  { MQTT_BARCODE_TOPIC_PARAM, 0 },
+  { MQTT_STATS_TOPIC_PARAM, 0 },
+  { MQTT_ERROR_TOPIC_PARAM, 0 },
+  { MQTT_ROUTES_PARAM, 0 },
+  { MQTT_BARCODE_FORMAT_PARAM, 0 },
+  { MQTT_BARCODE_FIELDS_PARAM, 0 },
+  { BARCODE_VALIDATE_PARAM, 0 },
+  { BARCODE_GUESS_PARAM, 0 },
+  { BARCODE_TRANSFORM_PARAM, 0 },
+  { GS1_DECODE_PARAM, 0 },
+  { MQTT_BUTTON_TOPIC_PARAM, APPLY_BUTTONS },
+  { MQTT_BUTTON_FORMAT_PARAM, APPLY_BUTTONS },
+  { MQTT_BUTTON_FIELDS_PARAM, APPLY_BUTTONS },
+  { DEDUP_MODE_PARAM, APPLY_DEDUP },
+  { DEDUP_WINDOW_PARAM, APPLY_DEDUP },
+  { LOOKUP_FILE_PARAM, APPLY_LOOKUP }
+};
+
+static uint8_t paramActions(const char *name) {
+  for (uint8_t i = 0; i < sizeof(HOT_PARAMS) / sizeof(HOT_PARAMS[0]); ++i) {
+    if (! strcmp_P(name, (PGM_P)pgm_read_ptr(&HOT_PARAMS[i].name)))
+      return pgm_read_byte(&HOT_PARAMS[i].actions);
+  }
+
+  return APPLY_RESTART;
+}
+
+static void applyConfigPatch() {
+  uint32_t start = micros();
+  char topic[Router::TOPIC_SIZE];
+  DynamicJsonDocument doc(config->jsonSize());
+  StaticJsonDocument<512> response;
+  JsonArray changed = response.createNestedArray(F("changed"));
+  JsonArray rejected = response.createNestedArray(F("rejected")); // Unknown parameters or wrong value types
+  uint8_t actions = 0;
+
+  snprintf_P(topic, sizeof(topic), PSTR("%s/response"), config->_mqtt_config_topic); // Before patch may change it
+
+  bool result = config->merge(configPatch, configPatchLen, doc, changed, rejected);
+
+  free(configPatch);
+  configPatch = NULL;
+  configPatchReady = false;
+  if (! result)
+    changed.clear(); // Patch is applied as a whole or not at all
+  if (result) {
+    for (const char *name : changed) {
+      actions |= paramActions(name);
+    }
+    if (actions & (APPLY_WIFI | APPLY_MQTT)) {
+      const char *ssid = doc[FPSTR(WIFI_SSID_PARAM)];
+      const char *server = doc[FPSTR(MQTT_SERVER_PARAM)];
+
+      if ((! ssid) || (! *ssid) || (! server) || (! *server)) // Captive portal needed
+        actions |= APPLY_RESTART;
+    }
+    if (! (actions & APPLY_RESTART)) { // Cold parameters are not applied until restart, sinks keep pointers to them
+      config->apply(doc);
+      if (actions & APPLY_MQTT)
+        mqttSettings(); // Takes effect on reconnect below
+      if (actions & APPLY_BUTTONS) {
+        prepareButtonPayloads();
+#ifndef ONE_BUTTON
+        prepareButtonTopics();
+#endif
+      }
+      if (actions & APPLY_DEDUP) {
+        dedup->setMode(config->_dedup_mode);
+        dedup->setWindow(config->_dedup_window);
+      }
+      if (actions & APPLY_LOOKUP)
+        openLookup();
+    }
+    if (changed.size())
+      result = config->save(doc);
+  }
+  response[F("result")] = result ? F("ok") : F("error");
+  response[F("restart")] = result && (actions & APPLY_RESTART);
+  response[F("apply_us")] = micros() - start;
+  LOG_I("Configuration patch %S, %u parameter(s) changed, %u rejected", result ? PSTR("applied") : PSTR("rejected"), changed.size(),
+    rejected.size());
+  {
+    char value[512];
+
+    mqtt->publish(topic, 1, false, value, serializeJson(response, value, sizeof(value)));
+  }
+  if (result) {
+    if (actions & APPLY_RESTART) {
+      restartTime = millis() | 1; // 0 means no restart pending
+    } else if (actions & (APPLY_WIFI | APPLY_MQTT)) {
+      reconnectTime = millis() | 1;
+      reconnectActions = actions;
+    }
+  }
+}
+
+static void reconnect() {
+  reconnectTime = 0;
+  if (reconnectActions & APPLY_WIFI) {
+    WiFi.disconnect();
+    wifiLastConnecting = 0;
+  } else if (reconnectActions & APPLY_MQTT) {
+    mqtt->disconnect();
+    mqttLastConnecting = 0;
+  }
+}
+
 void setup() {
   Serial.begin(9600);
   Serial.println();
 
-  if (! initSPIFFS())
-    halt(F("Error initialization SPIFFS!"));
+#ifdef USE_SERIAL
+  logger.addSink(new SerialLogSink(Serial));
+#endif
+#ifdef LOG_UART1
+  Serial1.begin(115200);
+  logger.addSink(new SerialLogSink(Serial1));
+#endif
+
+  if (! initFS())
+    halt(F("Error initialization " FILESYSTEM_NAME "!"));
+#ifdef FS_BENCHMARK
+  benchmarkFS(FS_BENCHMARK);
+#endif
   config = new Config();
   if (! config->load()) {
     config->clear();
+    LOG_I("Use default configuration");
+  }
+
+  if (config->_gm65_baud) { // Needs ESP TX connected to GM65 RX
+    GM65 gm65(Serial);
+
+    LOG_I("Configuring GM65 scanner...");
+    logger.flush();
 #ifdef USE_SERIAL
-    Serial.println(F("Use default configuration"));
+    Serial.flush();
 #endif
+    if (gm65.begin(config->_gm65_baud) && gm65.setMode(config->_gm65_mode) && gm65.setTail(config->_gm65_tail) &&
+      gm65.setCodeId(config->_gm65_code_id) && gm65.enableSymbologies(config->_gm65_symbologies) && ((! config->_gm65_save) || gm65.save()))
+      LOG_I("GM65 configured at %u baud", gm65.baud());
+    else
+      LOG_E("GM65 configuration error!");
+    if (config->_gm65_tail == GM65_TAIL_TAB)
+      barcodeTerminator = '\t';
+    else if (config->_gm65_tail == GM65_TAIL_NONE)
+      barcodeTerminator = '\0';
   }
 
+  if (Serial.setRxBufferSize(config->_uart_rx_buffer) != config->_uart_rx_buffer)
+    LOG_W("UART RX buffer resize error!");
+  if (config->_mqtt_log_topic)
+    logger.addSink(new MqttLogSink());
+  if (config->_syslog_server)
+    logger.addSink(new SyslogSink(config->_syslog_server, config->_syslog_port, config->_mqtt_client));
+
   events = new EventQueue();
+#ifdef ONE_BUTTON
   btn = new Button(BTN_PIN, LOW, events);
+#else
+  btn = new Buttons(events);
+  for (uint8_t i = 0; i < BTN_COUNT; ++i)
+    btn->add(BTN_PINS[i], LOW);
+  prepareButtonTopics();
+#endif
   led = new Led(LED_PIN, LED_LEVEL);
+  dedup = new Dedup(config->_dedup_mode, config->_dedup_window);
+  prepareButtonPayloads();
+  openLookup();
 
   {
     bool cpNeeded = (! config->_wifi_ssid) || (! config->_mqtt_server) || (! config->_mqtt_client);
@@ -379,11 +1752,11 @@ void setup() {
 
       uint32_t start = millis();
 
-#ifdef USE_SERIAL
-      Serial.println(F("Press button during 2 sec. to start captive portal..."));
-#endif
+      LOG_I("Press button during 2 sec. to start captive portal...");
+      logger.flush();
       led->setMode(LED_4HZ);
       while (millis() - start < WAIT_TIME) {
+        btn->update();
         if (events->depth()) { // Button was pressed
           cpNeeded = true;
           break;
@@ -404,24 +1777,67 @@ void setup() {
   }
 
   if (config->_wifi_ssid && config->_mqtt_server && config->_mqtt_client) {
-    mqtt = new AsyncMqttClient();
-    mqtt->setServer(config->_mqtt_server, config->_mqtt_port);
-    mqtt->setClientId(config->_mqtt_client);
-    if (config->_mqtt_user)
-      mqtt->setCredentials(config->_mqtt_user, config->_mqtt_pswd);
-    mqtt->onConnect(onMqttConnect);
+    bool secured = true; // Never fall back to weaker connection than configured
+#if ASYNC_TCP_SSL_ENABLED
+    uint8_t fingerprint[SHA1_SIZE];
+
+    if (config->_mqtt_secure && ((! config->_mqtt_fingerprint) ||
+      (hexToBytes(fingerprint, sizeof(fingerprint), config->_mqtt_fingerprint) != sizeof(fingerprint)))) { // No unpinned TLS
+      LOG_E("Missing or wrong MQTT server fingerprint, MQTT disabled!");
+      secured = false;
+    }
+#else
+    if (config->_mqtt_secure) {
+      LOG_E("TLS is not compiled in, use esp8285_tls environment! MQTT disabled");
+      secured = false;
+    }
+#endif
+    if (secured) {
+      mqtt = new AsyncMqttClient();
+      mqttSettings();
+      mqtt->onConnect(onMqttConnect);
+      mqtt->onPublish(onMqttPublish);
+      mqtt->onDisconnect(onMqttDisconnect);
+      mqtt->onMessage(onMqttMessage);
+      dispatcher.addSink(new MqttSink());
+#if ASYNC_TCP_SSL_ENABLED
+      if (config->_mqtt_secure) { // axTLS of ESPAsyncTCP has no session resumption and fixed record buffers
+        mqtt->setSecure(true);
+        mqtt->addServerFingerprint(fingerprint);
+      }
+#endif
+    }
+  }
+  if (config->_wifi_ssid && config->_http_url) {
+    httpSink = new HttpSink(config->_http_url, config->_http_batch);
+    dispatcher.addSink(httpSink);
+  }
+  if (config->_wifi_ssid && config->_udp_server) {
+    udpSink = new UdpSink(config->_udp_server, config->_udp_port, config->_mqtt_client, config->_udp_ack);
+    dispatcher.addSink(udpSink);
   }
   WiFi.mode(WIFI_STA);
   if (config->_wifi_ssid) {
     wifiConnectHandler = WiFi.onStationModeGotIP(onWifiConnect);
+    if (config->_ntp_server)
+      sysClock.begin(config->_ntp_server);
   }
   barcode[0] = '\0';
-#ifdef USE_SERIAL
-  Serial.println(F("MQTT BarScanner started"));
-#endif
+  LOG_I("MQTT BarScanner started");
 }
 
 void loop() {
+  uint32_t loopStart = micros();
+
+  readBarcodes();
+
+  {
+    uint32_t heap = ESP.getFreeHeap();
+
+    if (heap < heapMin) // Low-water mark, TLS handshake is the usual peak
+      heapMin = heap;
+  }
+
   if (config->_wifi_ssid) {
     if (! WiFi.isConnected())
       wifiConnect();
@@ -429,68 +1845,74 @@ void loop() {
       mqttConnect();
   }
 
+  btn->update();
   {
     event_t *evt;
 
     while ((evt = (event_t*)events->get()) != NULL) {
       if (evt->id == EVT_BTNCLICK) {
-        mqttPublishButton((btneventid_t)evt->id);
-#ifdef USE_SERIAL
-        Serial.println(F("Button clicked"));
-#endif
+        mqttPublishButton((btneventid_t)evt->id, evt->data);
+        LOG_I("Button clicked");
       } else if (evt->id == EVT_BTNDBLCLICK) {
-        mqttPublishButton((btneventid_t)evt->id);
-#ifdef USE_SERIAL
-        Serial.println(F("Button double clicked"));
-#endif
+        mqttPublishButton((btneventid_t)evt->id, evt->data);
+        LOG_I("Button double clicked");
       } else if (evt->id == EVT_BTNLONGCLICK) {
-        mqttPublishButton((btneventid_t)evt->id);
-#ifdef USE_SERIAL
-        Serial.println(F("Button long clicked"));
-#endif
+        mqttPublishButton((btneventid_t)evt->id, evt->data);
+        LOG_I("Button long clicked");
+        togglePortal();
 /*
         config->clear();
         config->save();
-#ifdef USE_SERIAL
-        Serial.println(F("Configuration resets to defaults!"));
-#endif
+        LOG_W("Configuration resets to defaults!");
         restart();
 */
+      } else if (evt->id == EVT_BTNMULTICLICK) {
+        mqttPublishButton((btneventid_t)evt->id, evt->data);
+        LOG_I("Button multi clicked");
+      }
+#ifndef ONE_BUTTON
+      else if (evt->id == EVT_BTNCHORD) {
+        mqttPublishButton((btneventid_t)evt->id, evt->data);
+        LOG_I("Buttons chord 0x%02X", evt->data);
       }
+#endif
     }
   }
 
-  if (Serial.available()) {
-    uint8_t codelen = strlen(barcode);
+  readBarcodes();
 
-    while (Serial.available()) {
-      char ch = Serial.read();
+  {
+    const uint32_t STATS_INTERVAL = 60000; // 60 sec.
 
-      if (ch == BARCODE_TERMINATOR) {
-#ifdef USE_SERIAL
-        Serial.print(F("Barcode: \""));
-        Serial.print(barcode);
-        Serial.println('"');
-#endif
-        mqttPublishBarcode(barcode);
-        barcode[0] = '\0';
-        codelen = 0;
-      } else {
-        barcode[codelen++] = ch;
-        barcode[codelen] = '\0';
-        if (codelen >= BARCODE_SIZE) {
-#ifdef USE_SERIAL
-          Serial.print(F("Barcode (cutted): \""));
-          Serial.print(barcode);
-          Serial.println('"');
-#endif
-          mqttPublishBarcode(barcode);
-          barcode[0] = '\0';
-          codelen = 0;
-        }
-      }
+    static uint32_t lastStats = 0;
+
+    if (millis() - lastStats >= STATS_INTERVAL) {
+      if (mqttPublishStats())
+        lastStats = millis();
     }
   }
 
-  led->delay(1);
+  if (configPatchReady)
+    applyConfigPatch();
+  if ((ota.state() == OTA_DONE) && (! restartTime)) {
+    LOG_I("Firmware updated over MQTT");
+    restartTime = millis() | 1;
+  }
+  if (restartTime && (millis() - restartTime >= 1000)) // Let response reach the broker
+    restart();
+  if (reconnectTime && (millis() - reconnectTime >= 1000)) // Same for response published with old settings
+    reconnect();
+
+  dispatcher.process();
+  if (portal) {
+    uint32_t start = micros();
+    bool active = portal->process();
+
+    portalTime.add(micros() - start);
+    if (! active)
+      togglePortal();
+  }
+  logger.drain();
+  loopTime.add(micros() - loopStart);
+  waitBarcodes(1);
 }
@@ -0,0 +1,90 @@
+#ifndef __ARDUINO_H
+#define __ARDUINO_H
+
+// Minimal Arduino API for host unit tests (pio test -e native)
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pgmspace.h"
+
+#define __packed __attribute__((packed))
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x00
+#define INPUT_PULLUP 0x02
+#define CHANGE 0x03
+
+inline uint32_t &fakeMillis() { // Test controlled time, yield() and delay() advance it
+  static uint32_t ms = 0;
+
+  return ms;
+}
+
+inline uint32_t &fakeGpi() { // Input levels, bit per GPIO
+  static uint32_t gpi = 0xFFFFFFFF;
+
+  return gpi;
+}
+
+#define GPI (fakeGpi())
+
+inline uint32_t millis() {
+  return fakeMillis();
+}
+
+inline uint64_t micros64() {
+  return (uint64_t)fakeMillis() * 1000;
+}
+
+inline void yield() {
+  ++fakeMillis();
+}
+
+inline void delay(uint32_t ms) {
+  fakeMillis() += ms;
+}
+
+inline char *ultoa(unsigned long value, char *str, int radix) {
+  char *p = str;
+
+  do {
+    uint8_t digit = value % radix;
+
+    *p++ = (digit < 10) ? '0' + digit : 'a' + digit - 10;
+    value /= radix;
+  } while (value);
+  *p = '\0';
+  for (char *q = str; q < --p; ++q) {
+    char c = *q;
+
+    *q = *p;
+    *p = c;
+  }
+
+  return str;
+}
+
+inline void configTime(int, int, const char*) {}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void attachInterruptArg(uint8_t, void (*)(void*), void*, int) {}
+inline void detachInterrupt(uint8_t) {}
+
+class HardwareSerial { // Tests derive simulated peers from it
+public:
+  virtual ~HardwareSerial() {}
+
+  virtual void updateBaudRate(unsigned long baud) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+  virtual void flush() {}
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __ESP8266WIFI_H
+#define __ESP8266WIFI_H
+
+// Host build: station state set by the test
+
+#include <Arduino.h>
+
+class ESP8266WiFiClass {
+public:
+  ESP8266WiFiClass() : connected(false) {}
+
+  bool isConnected() {
+    return connected;
+  }
+
+  bool connected;
+};
+
+inline ESP8266WiFiClass &fakeWiFi() {
+  static ESP8266WiFiClass wifi;
+
+  return wifi;
+}
+
+#define WiFi (fakeWiFi())
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef __ESPASYNCTCP_H
+#define __ESPASYNCTCP_H
+
+// Host build: the test plays the server side of the last created client
+
+#include <functional>
+#include <string>
+#include <Arduino.h>
+
+class AsyncClient;
+
+typedef std::function<void(void*, AsyncClient*)> AcConnectHandler;
+typedef std::function<void(void*, AsyncClient*, void *data, size_t len)> AcDataHandler;
+
+class AsyncClient {
+public:
+  AsyncClient() : connecting(false), connected(false), window(2920) {
+    last() = this;
+  }
+  ~AsyncClient() {
+    if (last() == this)
+      last() = NULL;
+  }
+
+  static AsyncClient *&last() {
+    static AsyncClient *client = NULL;
+
+    return client;
+  }
+
+  void onConnect(AcConnectHandler cb, void *arg) {
+    _connectcb = cb;
+    _connectarg = arg;
+  }
+  void onDisconnect(AcConnectHandler cb, void *arg) {
+    _disconnectcb = cb;
+    _disconnectarg = arg;
+  }
+  void onData(AcDataHandler cb, void *arg) {
+    _datacb = cb;
+    _dataarg = arg;
+  }
+  bool connect(const char *h, uint16_t p) {
+    host = h;
+    port = p;
+    connecting = true;
+
+    return true;
+  }
+  void close(bool now = false) {
+    (void)now;
+    if (connecting || connected) {
+      connecting = connected = false;
+      if (_disconnectcb)
+        _disconnectcb(_disconnectarg, this);
+    }
+  }
+  size_t space() {
+    return connected ? window : 0;
+  }
+  size_t add(const char *data, size_t size) {
+    _pending.append(data, size);
+
+    return size;
+  }
+  bool send() {
+    sent += _pending;
+    _pending.clear();
+
+    return true;
+  }
+
+  void accept() { // Server side
+    connecting = false;
+    connected = true;
+    if (_connectcb)
+      _connectcb(_connectarg, this);
+  }
+  void reply(const char *data, size_t size) {
+    if (_datacb)
+      _datacb(_dataarg, this, (void*)data, size);
+  }
+
+  std::string host;
+  uint16_t port;
+  bool connecting;
+  bool connected;
+  size_t window;
+  std::string sent;
+
+protected:
+  AcConnectHandler _connectcb;
+  void *_connectarg;
+  AcConnectHandler _disconnectcb;
+  void *_disconnectarg;
+  AcDataHandler _datacb;
+  void *_dataarg;
+  std::string _pending;
+};
+
+#endif
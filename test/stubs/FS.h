@@ -0,0 +1,76 @@
+#ifndef __FS_H
+#define __FS_H
+
+// Host build: SPIFFS is a directory of the host filesystem, files are stdio streams
+
+#include <Arduino.h>
+#include <WString.h>
+
+enum SeekMode {
+  SeekSet = SEEK_SET,
+  SeekCur = SEEK_CUR,
+  SeekEnd = SEEK_END
+};
+
+inline const char *&fakeFSRoot() { // Directory holding the test's files
+  static const char *root = ".";
+
+  return root;
+}
+
+class File {
+public:
+  File(FILE *f = NULL) : _f(f) {}
+
+  operator bool() const {
+    return _f != NULL;
+  }
+  size_t read(uint8_t *buf, size_t size) {
+    return fread(buf, 1, size, _f);
+  }
+  bool seek(uint32_t pos, SeekMode mode) {
+    return ! fseek(_f, pos, mode);
+  }
+  size_t size() const {
+    long pos = ftell(_f);
+    long result;
+
+    fseek(_f, 0, SEEK_END);
+    result = ftell(_f);
+    fseek(_f, pos, SEEK_SET);
+
+    return result;
+  }
+  void close() {
+    if (_f) {
+      fclose(_f);
+      _f = NULL;
+    }
+  }
+
+protected:
+  FILE *_f;
+};
+
+class Dir {};
+
+class FS {
+public:
+  File open(const char *path, const char *mode) {
+    char name[256];
+
+    snprintf(name, sizeof(name), "%s/%s", fakeFSRoot(), (*path == '/') ? path + 1 : path);
+
+    return File(fopen(name, (*mode == 'r') ? "rb" : "wb"));
+  }
+};
+
+inline FS &fakeSPIFFS() {
+  static FS fs;
+
+  return fs;
+}
+
+#define SPIFFS (fakeSPIFFS())
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef __WSTRING_H
+#define __WSTRING_H
+
+// Host build: flash strings are ordinary strings
+
+class __FlashStringHelper;
+class String;
+
+#endif
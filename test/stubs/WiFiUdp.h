@@ -0,0 +1,69 @@
+#ifndef __WIFIUDP_H
+#define __WIFIUDP_H
+
+// Host build: datagrams go to a queue the test inspects, replies come from a queue the test fills
+
+#include <deque>
+#include <string>
+#include <Arduino.h>
+
+struct FakeUdpNet {
+  std::deque<std::string> sent;
+  std::deque<std::string> received;
+  std::string host;
+  uint16_t port;
+  uint16_t local;
+};
+
+inline FakeUdpNet &fakeUdpNet() {
+  static FakeUdpNet net;
+
+  return net;
+}
+
+class WiFiUDP {
+public:
+  uint8_t begin(uint16_t port) {
+    fakeUdpNet().local = port;
+
+    return 1;
+  }
+  int beginPacket(const char *host, uint16_t port) {
+    fakeUdpNet().host = host;
+    fakeUdpNet().port = port;
+    _packet.clear();
+
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) {
+    _packet.append((const char*)buffer, size);
+
+    return size;
+  }
+  int endPacket() {
+    fakeUdpNet().sent.push_back(_packet);
+
+    return 1;
+  }
+  int parsePacket() {
+    if (fakeUdpNet().received.empty())
+      return 0;
+    _packet = fakeUdpNet().received.front();
+    fakeUdpNet().received.pop_front();
+
+    return _packet.size();
+  }
+  int read(uint8_t *buffer, size_t len) {
+    if (len > _packet.size())
+      len = _packet.size();
+    memcpy(buffer, _packet.data(), len);
+    _packet.erase(0, len);
+
+    return len;
+  }
+
+protected:
+  std::string _packet;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __COREDECLS_H
+#define __COREDECLS_H
+
+// Host build: SNTP never sets the time
+
+inline void settimeofday_cb(void (*)()) {}
+
+#endif
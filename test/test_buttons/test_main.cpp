@@ -0,0 +1,120 @@
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+#include "Buttons.h"
+
+// Replays recorded button edge traces through ISR ring and loop classifier
+
+struct _trace_edge_t {
+  uint16_t time; // ms. from trace start
+  bool pressed;
+};
+
+class TraceButton : public Button {
+public:
+  TraceButton(EventQueue *events) : Button(PIN, LOW, events) {}
+
+  void edge(bool pressed) { // What pin interrupt sees
+    if (pressed)
+      GPI &= ~(1 << PIN);
+    else
+      GPI |= 1 << PIN;
+    _isr(this);
+  }
+
+  static const uint8_t PIN = 0;
+};
+
+static std::string replay(const _trace_edge_t *edges, uint8_t count, uint16_t duration) {
+  EventQueue events;
+  TraceButton button(&events);
+  uint32_t start = millis();
+  uint8_t next = 0;
+  std::string result;
+
+  for (uint16_t t = 0; t <= duration; ++t) {
+    fakeMillis() = start + t;
+    while ((next < count) && (edges[next].time == t))
+      button.edge(edges[next++].pressed);
+    if (! (t % 5)) // Loop is not called every ms
+      button.update();
+  }
+  while (const event_t *e = events.get()) {
+    static const char NAMES[] = "RPCLDMH";
+
+    if (! result.empty())
+      result += ' ';
+    result += NAMES[e->id - EVT_BTNBASE];
+    if (e->data)
+      result += std::to_string(e->data);
+  }
+
+  return result;
+}
+
+#define REPLAY(trace, duration) replay(trace, sizeof(trace) / sizeof(trace[0]), duration).c_str()
+
+void setUp() {
+  fakeMillis() = 1000;
+  fakeGpi() = 0xFFFFFFFF; // Released, active low
+}
+
+void tearDown() {}
+
+static void test_bounce() {
+  static const _trace_edge_t TRACE[] = { { 0, true }, { 2, false }, { 4, true }, { 120, false }, { 121, true }, { 123, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P R C1", REPLAY(TRACE, 1000));
+}
+
+static void test_glitch() {
+  static const _trace_edge_t TRACE[] = { { 0, true }, { 8, false }, { 300, true }, { 301, false } };
+
+  TEST_ASSERT_EQUAL_STRING("", REPLAY(TRACE, 1000));
+}
+
+static void test_double() {
+  static const _trace_edge_t TRACE[] = { { 0, true }, { 100, false }, { 300, true }, { 302, false }, { 303, true }, { 400, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P R P R D2", REPLAY(TRACE, 1500));
+}
+
+static void test_triple() {
+  static const _trace_edge_t TRACE[] = { { 0, true }, { 100, false }, { 300, true }, { 400, false }, { 600, true }, { 700, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P R P R P R M3", REPLAY(TRACE, 1500));
+}
+
+static void test_hold() {
+  static const _trace_edge_t TRACE[] = { { 0, true }, { 3000, false }, { 3001, true }, { 3004, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P L R", REPLAY(TRACE, 4000));
+}
+
+static void test_slow_clicks() {
+  static const _trace_edge_t TRACE[] = { { 0, true }, { 100, false }, { 800, true }, { 900, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P R C1 P R C1", REPLAY(TRACE, 2000));
+}
+
+static void test_edges_lost() {
+  EventQueue events;
+  TraceButton button(&events);
+
+  for (uint8_t i = 0; i < 40; ++i) // Loop stalled, ring overflows
+    button.edge(i & 0x01);
+  TEST_ASSERT_TRUE(button.edgesLost() > 0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bounce);
+  RUN_TEST(test_glitch);
+  RUN_TEST(test_double);
+  RUN_TEST(test_triple);
+  RUN_TEST(test_hold);
+  RUN_TEST(test_slow_clicks);
+  RUN_TEST(test_edges_lost);
+
+  return UNITY_END();
+}
@@ -0,0 +1,147 @@
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+#include "Buttons.h"
+
+// Replays recorded edge traces of several buttons, built with -DMULTI_BUTTON (pio test -e native_buttons)
+
+struct _trace_edge_t {
+  uint16_t time; // ms. from trace start
+  uint8_t button;
+  bool pressed;
+};
+
+class TraceButtons : public Buttons {
+public:
+  TraceButtons(EventQueue *events) : Buttons(events) {
+    for (uint8_t i = 0; i < sizeof(PINS); ++i)
+      add(PINS[i], LOW);
+  }
+
+  void edge(uint8_t button, bool pressed) { // What interrupt of this pin sees
+    uint8_t gpio = PINS[button];
+
+    if (pressed)
+      GPI &= ~(1 << gpio);
+    else
+      GPI |= 1 << gpio;
+    _isr(&_pinargs[gpio]);
+  }
+
+  static const uint8_t PINS[3];
+};
+
+const uint8_t TraceButtons::PINS[3] = { 0, 2, 4 };
+
+static std::string replay(const _trace_edge_t *edges, uint8_t count, uint16_t duration) {
+  EventQueue events;
+  TraceButtons buttons(&events);
+  uint32_t start = millis();
+  uint8_t next = 0;
+  std::string result;
+
+  for (uint16_t t = 0; t <= duration; ++t) {
+    fakeMillis() = start + t;
+    while ((next < count) && (edges[next].time == t)) {
+      buttons.edge(edges[next].button, edges[next].pressed);
+      ++next;
+    }
+    if (! (t % 5)) // Loop is not called every ms
+      buttons.update();
+  }
+  while (const event_t *e = events.get()) {
+    static const char NAMES[] = "RPCLDMH";
+
+    if (! result.empty())
+      result += ' ';
+    result += NAMES[e->id - EVT_BTNBASE];
+    if (e->id == EVT_BTNCHORD) {
+      result += std::to_string(e->data); // Mask of buttons
+    } else {
+      result += std::to_string(e->data & 0x0F);
+      if (e->data >> 4)
+        result += ':' + std::to_string(e->data >> 4);
+    }
+  }
+
+  return result;
+}
+
+#define REPLAY(trace, duration) replay(trace, sizeof(trace) / sizeof(trace[0]), duration).c_str()
+
+void setUp() {
+  fakeMillis() = 1000;
+  fakeGpi() = 0xFFFFFFFF; // Released, active low
+}
+
+void tearDown() {}
+
+static void test_separate_clicks() {
+  static const _trace_edge_t TRACE[] = { { 0, 0, true }, { 100, 0, false }, { 300, 1, true }, { 400, 1, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P0 R0 P1 R1 C0:1 C1:1", REPLAY(TRACE, 1500));
+}
+
+static void test_interleaved_clicks() { // Each button keeps its own sequence timing
+  static const _trace_edge_t TRACE[] = { { 0, 0, true }, { 100, 0, false }, { 200, 1, true }, { 250, 1, false }, { 300, 0, true },
+    { 400, 0, false }, { 600, 1, true }, { 700, 1, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P0 R0 P1 R1 P0 R0 P1 R1 D0:2 D1:2", REPLAY(TRACE, 1500));
+}
+
+static void test_chord_release_order() {
+  static const _trace_edge_t FIRST_OUT[] = { { 0, 0, true }, { 50, 1, true }, { 300, 0, false }, { 350, 1, false } };
+  static const _trace_edge_t LAST_OUT[] = { { 0, 0, true }, { 50, 1, true }, { 300, 1, false }, { 350, 0, false } };
+  static const _trace_edge_t TOGETHER[] = { { 0, 1, true }, { 0, 0, true }, { 300, 0, false }, { 300, 1, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P0 P1 R0 R1 H3", REPLAY(FIRST_OUT, 1500)); // No clicks for chorded buttons
+  TEST_ASSERT_EQUAL_STRING("P0 P1 R1 R0 H3", REPLAY(LAST_OUT, 1500));
+  TEST_ASSERT_EQUAL_STRING("P0 P1 R0 R1 H3", REPLAY(TOGETHER, 1500)); // Same ms, settled in button order
+}
+
+static void test_chord_of_three() {
+  static const _trace_edge_t TRACE[] = { { 0, 2, true }, { 40, 0, true }, { 200, 2, false }, { 250, 1, true }, { 400, 1, false },
+    { 450, 0, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P2 P0 R2 P1 R1 R0 H7", REPLAY(TRACE, 1500)); // Held button keeps chord open
+}
+
+static void test_chord_blocks_long_click() {
+  static const _trace_edge_t TRACE[] = { { 0, 0, true }, { 100, 1, true }, { 2500, 1, false }, { 2600, 0, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P0 P1 R1 R0 H3", REPLAY(TRACE, 3500));
+}
+
+static void test_long_click_then_chord() {
+  static const _trace_edge_t TRACE[] = { { 0, 0, true }, { 2500, 1, true }, { 2600, 1, false }, { 2700, 0, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P0 L0 P1 R1 R0 H3", REPLAY(TRACE, 3500));
+}
+
+static void test_bounce_during_chord() { // Debounce is per button, bounce of one does not delay other
+  static const _trace_edge_t TRACE[] = { { 0, 0, true }, { 100, 1, true }, { 102, 1, false }, { 105, 1, true }, { 110, 0, false },
+    { 300, 1, false }, { 301, 1, true }, { 303, 1, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P0 P1 R0 R1 H3", REPLAY(TRACE, 1500));
+}
+
+static void test_chord_then_click() { // Chord mask is cleared once all buttons are released
+  static const _trace_edge_t TRACE[] = { { 0, 0, true }, { 50, 1, true }, { 300, 0, false }, { 350, 1, false }, { 500, 1, true },
+    { 600, 1, false } };
+
+  TEST_ASSERT_EQUAL_STRING("P0 P1 R0 R1 H3 P1 R1 C1:1", REPLAY(TRACE, 1500));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_separate_clicks);
+  RUN_TEST(test_interleaved_clicks);
+  RUN_TEST(test_chord_release_order);
+  RUN_TEST(test_chord_of_three);
+  RUN_TEST(test_chord_blocks_long_click);
+  RUN_TEST(test_long_click_then_chord);
+  RUN_TEST(test_bounce_during_chord);
+  RUN_TEST(test_chord_then_click);
+
+  return UNITY_END();
+}
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <Arduino.h>
+#include <unity.h>
+#include "Dedup.h"
+
+// Duplicate suppression window, modes and cost per scan at scanner rates
+
+static bool scan(Dedup &dedup, const char *code, const char *topic = NULL) { // Like processBarcode(), true if published
+  if (dedup.isDuplicate(code, strlen(code), topic))
+    return false;
+  dedup.remember(code, strlen(code), topic);
+
+  return true;
+}
+
+void setUp() {
+  fakeMillis() = 1000;
+}
+
+void tearDown() {}
+
+static void test_window() {
+  Dedup dedup(DEDUP_GLOBAL, 1000);
+
+  TEST_ASSERT_TRUE(scan(dedup, "4006381333931"));
+  fakeMillis() += 500;
+  TEST_ASSERT_FALSE(scan(dedup, "4006381333931"));
+  TEST_ASSERT_TRUE(scan(dedup, "5901234123457"));
+  fakeMillis() += 999; // Repeat slid the window
+  TEST_ASSERT_FALSE(scan(dedup, "4006381333931"));
+  fakeMillis() += 1000;
+  TEST_ASSERT_TRUE(scan(dedup, "4006381333931"));
+  TEST_ASSERT_EQUAL(2, dedup.suppressed());
+}
+
+static void test_not_remembered() {
+  Dedup dedup(DEDUP_GLOBAL, 1000);
+
+  TEST_ASSERT_FALSE(dedup.isDuplicate("12345", 5)); // Publish failed, nothing recorded
+  TEST_ASSERT_FALSE(dedup.isDuplicate("12345", 5));
+  dedup.remember("12345", 5);
+  TEST_ASSERT_TRUE(dedup.isDuplicate("12345", 5));
+  TEST_ASSERT_FALSE(dedup.isDuplicate("1234", 4));
+}
+
+static void test_modes() {
+  Dedup dedup(DEDUP_TOPIC, 1000);
+
+  TEST_ASSERT_TRUE(scan(dedup, "12345", "a"));
+  TEST_ASSERT_TRUE(scan(dedup, "12345", "b"));
+  TEST_ASSERT_FALSE(scan(dedup, "12345", "a"));
+  dedup.setMode(DEDUP_GLOBAL);
+  TEST_ASSERT_TRUE(scan(dedup, "12345", "a"));
+  TEST_ASSERT_FALSE(scan(dedup, "12345", "b"));
+  dedup.setMode(DEDUP_OFF);
+  TEST_ASSERT_TRUE(scan(dedup, "12345"));
+  TEST_ASSERT_TRUE(scan(dedup, "12345"));
+}
+
+static void test_full_table() {
+  Dedup dedup(DEDUP_GLOBAL, 60000);
+  char code[8];
+
+  for (uint16_t i = 0; i < 1000; ++i) { // Many more codes than slots, oldest are forgotten
+    snprintf(code, sizeof(code), "%05u", i);
+    TEST_ASSERT_TRUE(scan(dedup, code));
+    ++fakeMillis();
+  }
+  TEST_ASSERT_FALSE(scan(dedup, code)); // Latest is still known
+  TEST_ASSERT_TRUE(scan(dedup, "00000"));
+}
+
+static void test_benchmark() {
+  static const uint32_t CODES = 100000;
+  static const uint8_t REPEATS = 3; // Continuous mode reports each label several times
+
+  Dedup dedup(DEDUP_TOPIC, 1000);
+  char code[16];
+  uint32_t published = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < CODES; ++i) {
+    snprintf(code, sizeof(code), "40063813%05u", i);
+    for (uint8_t r = 0; r < REPEATS; ++r) {
+      if (scan(dedup, code, "scanner/barcode"))
+        ++published;
+      ++fakeMillis(); // 1000 scans per second
+    }
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (CODES * REPEATS);
+  char msg[80];
+
+  snprintf(msg, sizeof(msg), "%u scans, %.0f ns per scan, %.0f scans/s", CODES * REPEATS, ns, 1e9 / ns);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL(CODES, published);
+  TEST_ASSERT_EQUAL(CODES * (REPEATS - 1), dedup.suppressed());
+  TEST_ASSERT_TRUE(ns < 1000000); // Far above 1000 scans per second, probes are bounded by table size
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_window);
+  RUN_TEST(test_not_remembered);
+  RUN_TEST(test_modes);
+  RUN_TEST(test_full_table);
+  RUN_TEST(test_benchmark);
+
+  return UNITY_END();
+}
@@ -0,0 +1,240 @@
+#include <deque>
+#include <unity.h>
+#include "GM65.h"
+#include "Symbology.h"
+
+// Simulated GM65 on the other end of the UART, answers command frames like the module
+
+// Zone 0x0060 bits from the user manual: 6..5 - tail type, 2 - Code ID, 0 - allow tail, others are kept
+static const uint8_t TAIL_CR = 0x00 << 5;
+static const uint8_t TAIL_CRLF = 0x01 << 5;
+static const uint8_t TAIL_TAB = 0x02 << 5;
+static const uint8_t TAIL_NONE = 0x03 << 5;
+static const uint8_t CODE_ID = 0x04;
+static const uint8_t ALLOW_TAIL = 0x01;
+static const uint8_t OTHER_BITS = 0x80 | 0x18 | 0x02;
+
+// Enable zones (bit 0) from the user manual
+static const struct {
+  symbology_t symbology;
+  uint8_t zone;
+} ZONES[] = {
+  { SYM_EAN13, 0x2E }, { SYM_EAN8, 0x2F }, { SYM_UPCA, 0x30 }, { SYM_UPCE, 0x31 }, { SYM_UPCE, 0x32 }, // UPC-E0 and UPC-E1
+  { SYM_CODE128, 0x33 }, { SYM_CODE39, 0x36 }, { SYM_CODABAR, 0x3C }, { SYM_QR, 0x3F }, { SYM_ITF, 0x40 },
+  { SYM_DATAMATRIX, 0x54 }, { SYM_PDF417, 0x55 }
+};
+
+class GM65Sim : public HardwareSerial {
+public:
+  void reset() {
+    memset(zones, 0, sizeof(zones));
+    divider = 3000000UL / 9600; // Factory baud
+    host = 9600;
+    mute = false;
+    corrupt = false;
+    writes = 0;
+    saved = false;
+    rx.clear();
+  }
+
+  void updateBaudRate(unsigned long baud) {
+    host = baud;
+  }
+  int available() {
+    return rx.size();
+  }
+  int read() {
+    if (rx.empty())
+      return -1;
+
+    uint8_t result = rx.front();
+
+    rx.pop_front();
+
+    return result;
+  }
+  size_t write(const uint8_t *buffer, size_t size) {
+    if (mute || (3000000UL / host != divider)) // Wrong baud rate, scanner sees garbage
+      return size;
+    if ((size < 8) || (buffer[0] != 0x7E) || (buffer[1] != 0x00) || (size != 8U + buffer[3]))
+      return size;
+
+    uint16_t c = GM65::crc(&buffer[2], 4 + buffer[3]);
+
+    if ((buffer[6 + buffer[3]] != (c >> 8)) || (buffer[7 + buffer[3]] != (c & 0xFF)))
+      return size;
+
+    uint16_t address = (buffer[4] << 8) | buffer[5];
+
+    if (buffer[2] == 0x07) { // Read
+      reply(&zones[address], buffer[6]);
+    } else if (buffer[2] == 0x08) { // Write
+      uint8_t ok = 0x00;
+
+      memcpy(&zones[address], &buffer[6], buffer[3]);
+      ++writes;
+      reply(&ok, sizeof(ok));
+      if (address == 0x002A) // New baud rate after reply
+        divider = zones[0x2A] | (zones[0x2B] << 8);
+    } else if (buffer[2] == 0x09) { // Save
+      uint8_t ok = 0x00;
+
+      saved = true;
+      reply(&ok, sizeof(ok));
+    }
+
+    return size;
+  }
+
+  uint8_t zones[0x100];
+  uint16_t divider;
+  unsigned long host;
+  bool mute;
+  bool corrupt;
+  uint16_t writes;
+  bool saved;
+  std::deque<uint8_t> rx;
+
+protected:
+  void reply(const uint8_t *data, uint8_t len) {
+    uint8_t frame[4 + 255 + 2];
+
+    frame[0] = 0x02;
+    frame[1] = 0x00;
+    frame[2] = 0x00;
+    frame[3] = len;
+    memcpy(&frame[4], data, len);
+
+    uint16_t c = GM65::crc(&frame[2], 2 + len);
+
+    if (corrupt)
+      c ^= 0x0001;
+    frame[4 + len] = c >> 8;
+    frame[5 + len] = c & 0xFF;
+    rx.insert(rx.end(), frame, frame + 6 + len);
+  }
+};
+
+static GM65Sim sim;
+
+void setUp() {
+  sim.reset();
+}
+
+void tearDown() {}
+
+static void test_crc() {
+  TEST_ASSERT_EQUAL_HEX16(0x31C3, GM65::crc((const uint8_t*)"123456789", 9)); // CRC-CCITT (XModem) check value
+}
+
+static void test_begin_configured() {
+  GM65 gm65(sim);
+
+  sim.divider = 3000000UL / 115200;
+  TEST_ASSERT_TRUE(gm65.begin(115200));
+  TEST_ASSERT_EQUAL(0, sim.writes);
+  TEST_ASSERT_EQUAL(115200, gm65.baud());
+}
+
+static void test_begin_switches_baud() {
+  GM65 gm65(sim);
+
+  TEST_ASSERT_TRUE(gm65.begin(115200));
+  TEST_ASSERT_EQUAL(3000000UL / 115200, sim.divider);
+  TEST_ASSERT_EQUAL(115200, sim.host);
+  TEST_ASSERT_EQUAL(115200, gm65.baud());
+}
+
+static void test_begin_no_scanner() {
+  GM65 gm65(sim);
+  uint32_t start = millis();
+
+  sim.mute = true;
+  TEST_ASSERT_FALSE(gm65.begin(115200));
+  TEST_ASSERT_FALSE(gm65.begin(0));
+  TEST_ASSERT_TRUE(millis() - start < 1000); // Timeouts, no hang
+}
+
+static void test_settings() {
+  GM65 gm65(sim);
+
+  sim.zones[0x00] = 0xF0;
+  sim.zones[0x60] = OTHER_BITS | TAIL_CR | ALLOW_TAIL;
+  TEST_ASSERT_TRUE(gm65.setMode(GM65_CONTINUOUS));
+  TEST_ASSERT_EQUAL_HEX8(0xF2, sim.zones[0x00]);
+  TEST_ASSERT_TRUE(gm65.setTail(GM65_TAIL_CRLF));
+  TEST_ASSERT_EQUAL_HEX8(OTHER_BITS | TAIL_CRLF | ALLOW_TAIL, sim.zones[0x60]);
+  TEST_ASSERT_TRUE(gm65.setCodeId(true));
+  TEST_ASSERT_EQUAL_HEX8(OTHER_BITS | TAIL_CRLF | CODE_ID | ALLOW_TAIL, sim.zones[0x60]);
+  TEST_ASSERT_TRUE(gm65.setTail(GM65_TAIL_NONE));
+  TEST_ASSERT_EQUAL_HEX8(OTHER_BITS | TAIL_NONE | CODE_ID, sim.zones[0x60]);
+  TEST_ASSERT_TRUE(gm65.setTail(GM65_TAIL_TAB));
+  TEST_ASSERT_EQUAL_HEX8(OTHER_BITS | TAIL_TAB | CODE_ID | ALLOW_TAIL, sim.zones[0x60]);
+  TEST_ASSERT_TRUE(gm65.setCodeId(false));
+  TEST_ASSERT_EQUAL_HEX8(OTHER_BITS | TAIL_TAB | ALLOW_TAIL, sim.zones[0x60]);
+  TEST_ASSERT_TRUE(gm65.save());
+  TEST_ASSERT_TRUE(sim.saved);
+}
+
+static void test_unchanged_not_written() {
+  GM65 gm65(sim);
+
+  sim.zones[0x60] = TAIL_TAB | ALLOW_TAIL;
+  TEST_ASSERT_TRUE(gm65.setTail(GM65_TAIL_TAB));
+  TEST_ASSERT_TRUE(gm65.setTail(GM65_TAIL_KEEP));
+  TEST_ASSERT_TRUE(gm65.setMode(GM65_KEEP));
+  TEST_ASSERT_TRUE(gm65.enableSymbologies(0));
+  TEST_ASSERT_EQUAL(0, sim.writes);
+}
+
+static void test_symbologies() {
+  GM65 gm65(sim);
+
+  uint16_t mask = (1 << SYM_EAN13) | (1 << SYM_UPCE) | (1 << SYM_QR) | (1 << SYM_DATAMATRIX);
+
+  for (uint8_t i = 0; i < sizeof(ZONES) / sizeof(ZONES[0]); ++i)
+    sim.zones[ZONES[i].zone] = 0x01;
+  TEST_ASSERT_TRUE(gm65.enableSymbologies(mask));
+  for (uint8_t i = 0; i < sizeof(ZONES) / sizeof(ZONES[0]); ++i) {
+    char msg[16];
+
+    snprintf(msg, sizeof(msg), "Zone 0x%02X", ZONES[i].zone);
+    TEST_ASSERT_EQUAL_HEX8_MESSAGE((mask >> ZONES[i].symbology) & 0x01, sim.zones[ZONES[i].zone], msg);
+  }
+  TEST_ASSERT_EQUAL_HEX8(0x00, sim.zones[0x39]); // Neighbours are not touched
+  TEST_ASSERT_EQUAL_HEX8(0x00, sim.zones[0x41]);
+}
+
+static void test_bad_crc() {
+  GM65 gm65(sim);
+  uint8_t data;
+
+  sim.corrupt = true;
+  TEST_ASSERT_FALSE(gm65.readZone(0x0000, &data, sizeof(data)));
+}
+
+static void test_pending_barcode() {
+  GM65 gm65(sim);
+  uint8_t data;
+  const char *code = "4006381333931\r";
+
+  sim.zones[0x00] = 0x5A;
+  sim.rx.insert(sim.rx.end(), code, code + strlen(code)); // Scan arrived before command
+  TEST_ASSERT_TRUE(gm65.readZone(0x0000, &data, sizeof(data)));
+  TEST_ASSERT_EQUAL_HEX8(0x5A, data);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc);
+  RUN_TEST(test_begin_configured);
+  RUN_TEST(test_begin_switches_baud);
+  RUN_TEST(test_begin_no_scanner);
+  RUN_TEST(test_settings);
+  RUN_TEST(test_unchanged_not_written);
+  RUN_TEST(test_symbologies);
+  RUN_TEST(test_bad_crc);
+  RUN_TEST(test_pending_barcode);
+
+  return UNITY_END();
+}
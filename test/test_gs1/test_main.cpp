@@ -0,0 +1,105 @@
+#include <chrono>
+#include <Arduino.h>
+#include <unity.h>
+#include "GS1.h"
+#include "Symbology.h"
+
+// GS1 element strings decoded into the writer's map
+
+static char buf[256];
+
+static const char *decode(const char *data, payloadformat_t format = PAYLOAD_JSON) { // NULL if rejected
+  PayloadWriter writer(buf, sizeof(buf), format);
+
+  writer.beginMap();
+  if (! decodeGS1(data, strlen(data), writer))
+    return NULL;
+  writer.endMap();
+
+  return writer.c_str();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_label() {
+  TEST_ASSERT_EQUAL_STRING("{\"gtin\":\"00012345678905\",\"batch\":\"ABC\",\"expiry\":\"240101\"}",
+    decode("0100012345678905" "10ABC\x1d" "17240101"));
+  TEST_ASSERT_EQUAL_STRING("{\"sscc\":\"006141411234567890\"}", decode("\x1d" "00006141411234567890"));
+  TEST_ASSERT_EQUAL_STRING("{\"3103\":\"000123\",\"count\":\"12\"}", decode("3103000123" "3712"));
+}
+
+static void test_cbor() {
+  PayloadWriter writer(buf, sizeof(buf), PAYLOAD_CBOR);
+  static const uint8_t EXPECTED[] = { 0xBF, 0x66, 's', 'e', 'r', 'i', 'a', 'l', 0x62, 'A', '1', 0xFF };
+
+  writer.beginMap();
+  TEST_ASSERT_TRUE(decodeGS1("21A1", 4, writer));
+  writer.endMap();
+  TEST_ASSERT_EQUAL(sizeof(EXPECTED), writer.length());
+  TEST_ASSERT_EQUAL_MEMORY(EXPECTED, buf, sizeof(EXPECTED));
+}
+
+static void test_lengths() {
+  TEST_ASSERT_NOT_NULL(decode("2212345678901234567890123456789")); // 29 characters
+  TEST_ASSERT_NULL(decode("22123456789012345678901234567890"));
+  TEST_ASSERT_NULL(decode("01000123456789")); // Fixed length cut
+  TEST_ASSERT_NULL(decode("10\x1d" "17240101")); // Empty variable field
+}
+
+static void test_families() {
+  TEST_ASSERT_EQUAL_STRING("{\"417\":\"4012345000009\"}", decode("4174012345000009"));
+  TEST_ASSERT_NULL(decode("4184012345000009"));
+  TEST_ASSERT_NULL(decode("4194012345000009"));
+  TEST_ASSERT_NULL(decode("3170000123"));
+  TEST_ASSERT_EQUAL_STRING("{\"98\":\"X\"}", decode("98X"));
+}
+
+static void test_numeric() {
+  TEST_ASSERT_NULL(decode("0100012345A78905"));
+  TEST_ASSERT_NULL(decode("17ABCDEF"));
+  TEST_ASSERT_NULL(decode("3712A"));
+  TEST_ASSERT_NOT_NULL(decode("10A1-B2")); // Batch is alphanumeric
+}
+
+static void test_overflow() {
+  char small[16];
+  PayloadWriter writer(small, sizeof(small), PAYLOAD_JSON);
+
+  writer.beginMap();
+  TEST_ASSERT_FALSE(decodeGS1("0100012345678905", 16, writer));
+}
+
+static void test_benchmark() {
+  static const uint32_t ROUNDS = 100000;
+  static const char LABEL[] = "0100012345678905" "10ABC123\x1d" "17240101" "21SN0001";
+
+  uint32_t decoded = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < ROUNDS; ++i) {
+    if (decode(LABEL))
+      ++decoded;
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+  char msg[64];
+
+  snprintf(msg, sizeof(msg), "%.0f ns per 4 AI label", ns);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL(ROUNDS, decoded);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_label);
+  RUN_TEST(test_cbor);
+  RUN_TEST(test_lengths);
+  RUN_TEST(test_families);
+  RUN_TEST(test_numeric);
+  RUN_TEST(test_overflow);
+  RUN_TEST(test_benchmark);
+
+  return UNITY_END();
+}
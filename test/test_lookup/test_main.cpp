@@ -0,0 +1,154 @@
+#include <chrono>
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+#include "Lookup.h"
+
+// Index built by tools/mkindex.py from a generated CSV, lookups and page reads per lookup
+
+static const uint32_t RECORDS = 100000;
+
+static Lookup lookup;
+
+static std::string path(const char *name) {
+  return std::string(fakeFSRoot()) + "/" + name;
+}
+
+static void key(uint32_t i, char *code) {
+  snprintf(code, 14, "40%011u", i * 7); // Sparse keys, every other probe misses
+}
+
+static void writeCsv(const char *name, uint32_t records) {
+  FILE *csv = fopen(path(name).c_str(), "w");
+  char code[14];
+
+  TEST_ASSERT_NOT_NULL(csv);
+  for (uint32_t i = records; i > 0; --i) { // Unsorted on input
+    key(i - 1, code);
+    fprintf(csv, "%s,Item %u\n", code, i - 1);
+  }
+  fclose(csv);
+}
+
+static int mkindex(const char *options, const char *csv = "lookup.csv") { // 0 on success, like exit code of tools/mkindex.py
+  std::string root(__FILE__);
+  std::string::size_type pos = root.rfind("test/test_lookup");
+  std::string cmd;
+
+  root.erase(pos == std::string::npos ? 0 : pos);
+  cmd = root + "tools/mkindex.py " + options + " " + path(csv) + " " + path("lookup.idx") + " > " + path("mkindex.log") + " 2>&1";
+  if (! system(("python3 " + cmd).c_str()))
+    return 0;
+
+  return system(("python " + cmd).c_str());
+}
+
+void setUp() {
+  lookup.end();
+}
+
+void tearDown() {}
+
+static void test_build() {
+  writeCsv("lookup.csv", RECORDS);
+  TEST_ASSERT_EQUAL(0, mkindex(""));
+  TEST_ASSERT_TRUE(lookup.begin("/lookup.idx"));
+  TEST_ASSERT_EQUAL(RECORDS, lookup.count());
+  TEST_ASSERT_EQUAL(10, lookup.valueSize()); // "Item 99999"
+}
+
+static void test_find() {
+  char code[14];
+  char value[16];
+
+  TEST_ASSERT_TRUE(lookup.begin("/lookup.idx"));
+  for (uint32_t i = 0; i < RECORDS; i += 997) {
+    char expected[16];
+
+    key(i, code);
+    snprintf(expected, sizeof(expected), "Item %u", i);
+    TEST_ASSERT_TRUE(lookup.find(code, 13, value));
+    TEST_ASSERT_EQUAL_STRING(expected, value);
+  }
+  key(RECORDS - 1, code);
+  TEST_ASSERT_TRUE(lookup.find(code, 13, value));
+  TEST_ASSERT_FALSE(lookup.find("4000000000001", 13, value));
+  TEST_ASSERT_FALSE(lookup.find("0", 1, value)); // Before the first key
+  TEST_ASSERT_FALSE(lookup.find("99999999999999", 14, value)); // Longer than key size
+}
+
+static void test_small_pages() {
+  writeCsv("small.csv", 100);
+  TEST_ASSERT_EQUAL(0, mkindex("--page-size 32 --key-size 16", "small.csv")); // 2 keys per index page, 7 levels
+  TEST_ASSERT_TRUE(lookup.begin("/lookup.idx"));
+
+  char value[16];
+
+  TEST_ASSERT_TRUE(lookup.find("4000000000007", 13, value));
+  TEST_ASSERT_EQUAL_STRING("Item 1", value);
+  TEST_ASSERT_NOT_EQUAL(0, mkindex("--page-size 32 --key-size 17", "small.csv")); // Single key per index page never reaches the root
+}
+
+static void test_wrong_header() {
+  static const uint8_t HEADER[] = { 0x42, 0x49, 0x58, 0x31, 32, 0, 20, 10, 3, 0, 0, 0 }; // Page 32, key 20, value 10, 3 records
+
+  FILE *idx = fopen(path("lookup.idx").c_str(), "wb");
+  uint8_t page[32];
+
+  TEST_ASSERT_NOT_NULL(idx);
+  memset(page, 0, sizeof(page));
+  for (uint8_t i = 0; i < 16; ++i)
+    fwrite(page, sizeof(page), 1, idx);
+  fseek(idx, 0, SEEK_SET);
+  fwrite(HEADER, sizeof(HEADER), 1, idx);
+  fclose(idx);
+  TEST_ASSERT_FALSE(lookup.begin("/lookup.idx"));
+  TEST_ASSERT_FALSE(lookup.begin("/missing.idx"));
+}
+
+static void test_benchmark() {
+  static const uint32_t ROUNDS = 100000;
+
+  char code[14];
+  char value[16];
+  uint32_t found = 0;
+
+  TEST_ASSERT_EQUAL(0, mkindex("")); // Rebuilt from the big CSV
+  TEST_ASSERT_TRUE(lookup.begin("/lookup.idx"));
+  srand(1);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < ROUNDS; ++i) {
+    uint32_t r = (((uint32_t)rand() << 16) ^ rand()) % (RECORDS * 7);
+
+    snprintf(code, sizeof(code), "40%011u", r);
+    if (lookup.find(code, 13, value))
+      ++found;
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+  double reads = (double)lookup.reads() / ROUNDS;
+  char msg[80];
+
+  snprintf(msg, sizeof(msg), "%u records, %.2f page reads and %.0f ns per lookup", RECORDS, reads, ns);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_TRUE(found > ROUNDS / 10);
+  TEST_ASSERT_TRUE(reads < 3.0); // Root and upper index levels stay in cache
+  remove(path("lookup.csv").c_str());
+  remove(path("small.csv").c_str());
+  remove(path("lookup.idx").c_str());
+  remove(path("mkindex.log").c_str());
+}
+
+int main() {
+  fakeFSRoot() = P_tmpdir;
+  UNITY_BEGIN();
+  RUN_TEST(test_build);
+  RUN_TEST(test_find);
+  RUN_TEST(test_small_pages);
+  RUN_TEST(test_wrong_header);
+  RUN_TEST(test_benchmark);
+
+  return UNITY_END();
+}
@@ -0,0 +1,246 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <unity.h>
+#include "Output.h"
+
+// Fan-out dispatcher and HTTP/UDP sinks against local stand-ins of the TCP client and UDP socket
+
+class TestSink : public OutputSink { // Takes messages only when open
+public:
+  TestSink() : open(true) {}
+
+  bool ready() {
+    return open;
+  }
+  bool send(const char *topic, const char *payload, uint16_t len, uint64_t framed) {
+    (void)framed;
+    got.push_back(std::string(topic) + "=" + std::string(payload, len));
+
+    return true;
+  }
+
+  bool open;
+  std::vector<std::string> got;
+};
+
+static AsyncClient &server() { // Other end of HttpSink's connection
+  return *AsyncClient::last();
+}
+
+static void reply(const char *response, bool bytewise = false) {
+  if (bytewise) {
+    for (const char *p = response; *p; ++p)
+      server().reply(p, 1);
+  } else {
+    server().reply(response, strlen(response));
+  }
+}
+
+static void post(HttpSink &http, const char *a, const char *b) { // Fills batch of 2 and sends it, connects first if needed
+  TEST_ASSERT_TRUE(http.send("t", a, strlen(a), 0));
+  TEST_ASSERT_TRUE(http.send("t", b, strlen(b), 0));
+  TEST_ASSERT_FALSE(http.ready()); // Batch is full
+  if (! server().connected) {
+    http.process();
+    server().accept();
+  }
+  server().sent.clear();
+  http.process();
+  TEST_ASSERT_NOT_EQUAL(0, server().sent.size());
+}
+
+void setUp() {
+  fakeMillis() = 1000;
+  fakeWiFi().connected = true;
+  fakeUdpNet().sent.clear();
+  fakeUdpNet().received.clear();
+}
+
+void tearDown() {}
+
+static void test_fanout() {
+  Dispatcher dispatcher;
+  TestSink fast, slow;
+  char payload[4];
+
+  TEST_ASSERT_TRUE(dispatcher.addSink(&fast));
+  TEST_ASSERT_TRUE(dispatcher.addSink(&slow));
+  slow.open = false;
+  for (uint16_t i = 0; i < 100; ++i) { // 100 records of 19 bytes overflow 1 KB queue of slow sink only
+    snprintf(payload, sizeof(payload), "%03u", i);
+    dispatcher.publish("topic", payload, 3);
+  }
+  TEST_ASSERT_EQUAL(100, fast.got.size());
+  TEST_ASSERT_EQUAL(0, dispatcher.dropped(0));
+  TEST_ASSERT_EQUAL(0, slow.got.size());
+  TEST_ASSERT_TRUE(dispatcher.dropped(1) > 0);
+  slow.open = true;
+  dispatcher.process();
+  TEST_ASSERT_EQUAL(100 - dispatcher.dropped(1), slow.got.size());
+  TEST_ASSERT_EQUAL_STRING("topic=000", slow.got[0].c_str()); // Oldest kept, newest dropped
+  TEST_ASSERT_EQUAL_STRING("topic=099", fast.got[99].c_str());
+}
+
+static void test_http_request() {
+  HttpSink http("http://collector.local:8080/scans", 2);
+
+  TEST_ASSERT_TRUE(http.ready());
+  TEST_ASSERT_TRUE(http.send("t", "4006381333931", 13, 0));
+  http.process();
+  TEST_ASSERT_TRUE(server().connecting);
+  TEST_ASSERT_EQUAL_STRING("collector.local", server().host.c_str());
+  TEST_ASSERT_EQUAL(8080, server().port);
+  server().accept();
+  TEST_ASSERT_TRUE(http.send("t", "5901234123457", 13, 0));
+  http.process();
+  TEST_ASSERT_EQUAL_STRING("POST /scans HTTP/1.1\r\nHost: collector.local\r\nContent-Type: application/x-ndjson\r\n"
+    "Content-Length: 28\r\n\r\n4006381333931\n5901234123457\n", server().sent.c_str());
+  TEST_ASSERT_FALSE(http.ready()); // Waits for response
+  reply("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+  TEST_ASSERT_TRUE(http.ready());
+  TEST_ASSERT_EQUAL(0, http.errors());
+}
+
+static void test_http_framing() {
+  HttpSink http("http://collector.local/", 2);
+
+  post(http, "1", "2");
+  reply("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n10\r\n0123456789abcdef\r\n0\r\nX-Trailer: 1\r\n\r\n", true);
+  TEST_ASSERT_TRUE(http.ready());
+
+  post(http, "3", "4");
+  reply("HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n"); // Interim response is skipped
+  TEST_ASSERT_TRUE(http.ready());
+
+  post(http, "5", "6");
+  reply("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+  TEST_ASSERT_TRUE(http.ready());
+  TEST_ASSERT_EQUAL(0, http.errors());
+
+  post(http, "7", "8");
+  reply("HTTP/1.1 500 Internal Server Error\r\nContent-Length: 5\r\n\r\n");
+  TEST_ASSERT_FALSE(http.ready()); // Body is still coming
+  reply("error");
+  TEST_ASSERT_TRUE(http.ready()); // Rejected batch is dropped
+  TEST_ASSERT_EQUAL(1, http.errors());
+
+  post(http, "9", "10");
+  reply("HTTP/1.0 200 OK\r\n\r\nbody until close");
+  TEST_ASSERT_FALSE(http.ready());
+  server().close();
+  TEST_ASSERT_TRUE(http.ready());
+  TEST_ASSERT_EQUAL(1, http.errors());
+}
+
+static void test_http_timeout() {
+  HttpSink http("http://collector.local/", 1);
+
+  TEST_ASSERT_TRUE(http.send("t", "1", 1, 0));
+  http.process();
+  server().accept();
+  http.process();
+  TEST_ASSERT_FALSE(http.ready());
+  fakeMillis() += HttpSink::RESPONSE_TIMEOUT;
+  http.process();
+  TEST_ASSERT_EQUAL(1, http.errors());
+  TEST_ASSERT_FALSE(server().connected);
+  http.process(); // Batch is kept and sent again on new connection
+  TEST_ASSERT_TRUE(server().connecting);
+  server().accept();
+  server().sent.clear();
+  http.process();
+  TEST_ASSERT_TRUE(server().sent.find("\r\n\r\n1\n") != std::string::npos);
+}
+
+static void test_http_bad_url() {
+  HttpSink http("https://collector.local/", 1);
+
+  TEST_ASSERT_FALSE(http.ready());
+}
+
+static void test_udp_datagram() {
+  static const uint8_t EXPECTED[] = { 'B', 'S', 1, 0x01, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0x04, 0xD2, 4, 'd', 'e', 'v', '1', '4', '0', '0', '6' };
+  UdpSink udp("239.1.2.3", 5000, "dev1", true);
+
+  TEST_ASSERT_TRUE(udp.ready());
+  TEST_ASSERT_TRUE(udp.send("t", "4006", 4, 1234567)); // Framed at 1234.567 ms since boot, clock not synced
+  TEST_ASSERT_EQUAL(1, fakeUdpNet().sent.size());
+  TEST_ASSERT_EQUAL_STRING("239.1.2.3", fakeUdpNet().host.c_str());
+  TEST_ASSERT_EQUAL(5000, fakeUdpNet().port);
+  TEST_ASSERT_EQUAL(UdpSink::LOCAL_PORT, fakeUdpNet().local);
+  TEST_ASSERT_EQUAL(sizeof(EXPECTED), fakeUdpNet().sent[0].size());
+  TEST_ASSERT_EQUAL_MEMORY(EXPECTED, fakeUdpNet().sent[0].data(), sizeof(EXPECTED));
+  TEST_ASSERT_FALSE(udp.ready()); // Waits for ack
+  fakeUdpNet().received.push_back(std::string("BA\0\0\0\2", 6)); // Other seq
+  udp.process();
+  TEST_ASSERT_FALSE(udp.ready());
+  fakeUdpNet().received.push_back(std::string("BA\0\0\0\1", 6));
+  udp.process();
+  TEST_ASSERT_TRUE(udp.ready());
+  TEST_ASSERT_EQUAL(0, udp.retries());
+}
+
+static void test_udp_retries() {
+  UdpSink udp("10.0.0.1", 5000, "dev1", true);
+
+  TEST_ASSERT_TRUE(udp.send("t", "1", 1, 0));
+  for (uint8_t i = 0; i < UdpSink::MAX_RETRIES + 1; ++i) {
+    fakeMillis() += UdpSink::ACK_TIMEOUT;
+    udp.process();
+  }
+  TEST_ASSERT_EQUAL(1 + UdpSink::MAX_RETRIES, fakeUdpNet().sent.size());
+  TEST_ASSERT_EQUAL(UdpSink::MAX_RETRIES, udp.retries());
+  TEST_ASSERT_EQUAL(1, udp.lost());
+  TEST_ASSERT_TRUE(udp.ready());
+  TEST_ASSERT_TRUE(udp.send("t", "2", 1, 0));
+  TEST_ASSERT_EQUAL('\2', fakeUdpNet().sent.back()[7]); // Next seq
+  fakeWiFi().connected = false;
+  TEST_ASSERT_FALSE(udp.ready());
+}
+
+static void test_benchmark() {
+  static const uint32_t ROUNDS = 100000;
+
+  Dispatcher dispatcher;
+  TestSink sink;
+  UdpSink udp("10.0.0.1", 5000, "dev1", false);
+  uint32_t queued = 0;
+
+  dispatcher.addSink(&sink);
+  dispatcher.addSink(&udp);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < ROUNDS; ++i) {
+    queued += dispatcher.publish("scanner/barcode", "4006381333931", 13);
+    if (sink.got.size() >= 1000)
+      sink.got.clear();
+    if (fakeUdpNet().sent.size() >= 1000)
+      fakeUdpNet().sent.clear();
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+  char msg[64];
+
+  snprintf(msg, sizeof(msg), "%.0f ns per scan to 2 sinks", ns);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL(2 * ROUNDS, queued);
+  TEST_ASSERT_EQUAL(0, dispatcher.dropped(0) + dispatcher.dropped(1));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fanout);
+  RUN_TEST(test_http_request);
+  RUN_TEST(test_http_framing);
+  RUN_TEST(test_http_timeout);
+  RUN_TEST(test_http_bad_url);
+  RUN_TEST(test_udp_datagram);
+  RUN_TEST(test_udp_retries);
+  RUN_TEST(test_benchmark);
+
+  return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <Arduino.h>
+#include <unity.h>
+#include "PayloadWriter.h"
+
+// JSON and CBOR encoding, escaping and cost per scan payload
+
+static const char SEQ_KEY[] PROGMEM = "seq";
+static const char TIME_KEY[] PROGMEM = "time";
+static const char SYMBOLOGY_KEY[] PROGMEM = "symbology";
+static const char CODE_KEY[] PROGMEM = "code";
+static const char GS1_KEY[] PROGMEM = "gs1";
+static const char EAN13_NAME[] PROGMEM = "ean13";
+
+static char buf[256];
+
+static uint16_t encodeScan(payloadformat_t format, uint32_t seq) { // Same fields as processBarcode()
+  static const char CODE[] = "4006381333931";
+
+  if (format == PAYLOAD_RAW) {
+    memcpy(buf, CODE, sizeof(CODE) - 1);
+    return sizeof(CODE) - 1;
+  }
+
+  PayloadWriter writer(buf, sizeof(buf), format);
+
+  writer.beginMap();
+  writer.add(SEQ_KEY, seq);
+  writer.add(TIME_KEY, 1700000000123ULL);
+  writer.add(SYMBOLOGY_KEY, EAN13_NAME, strlen_P(EAN13_NAME), true);
+  writer.add(CODE_KEY, CODE, sizeof(CODE) - 1);
+  writer.endMap();
+
+  return writer.length();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_json() {
+  PayloadWriter writer(buf, sizeof(buf), PAYLOAD_JSON);
+
+  writer.beginMap();
+  writer.add(SEQ_KEY, 42);
+  writer.add(TIME_KEY, 1700000000123ULL);
+  writer.beginMap(GS1_KEY);
+  writer.add("01", 2, "00012345678905", 14);
+  writer.add("10", 2, "A", 1);
+  writer.endMap();
+  writer.add(CODE_KEY, "a\"b\\c\x1d", 6);
+  writer.endMap();
+  TEST_ASSERT_EQUAL_STRING("{\"seq\":42,\"time\":1700000000123,\"gs1\":{\"01\":\"00012345678905\",\"10\":\"A\"},\"code\":\"a\\\"b\\\\c\\u001d\"}",
+    writer.c_str());
+  TEST_ASSERT_FALSE(writer.overflow());
+}
+
+static void test_cbor() {
+  static const uint8_t EXPECTED[] = { 0xBF,
+    0x63, 's', 'e', 'q', 0x17,
+    0x63, 's', 'e', 'q', 0x18, 0x18,
+    0x63, 's', 'e', 'q', 0x19, 0x01, 0x00,
+    0x63, 's', 'e', 'q', 0x1A, 0x00, 0x01, 0x00, 0x00,
+    0x64, 't', 'i', 'm', 'e', 0x1B, 0x00, 0x00, 0x01, 0x8B, 0xCF, 0xE5, 0x68, 0x7B,
+    0x64, 'c', 'o', 'd', 'e', 0x62, 'a', '"',
+    0xFF };
+  PayloadWriter writer(buf, sizeof(buf), PAYLOAD_CBOR);
+
+  writer.beginMap();
+  writer.add(SEQ_KEY, 23);
+  writer.add(SEQ_KEY, 24);
+  writer.add(SEQ_KEY, 256);
+  writer.add(SEQ_KEY, 65536);
+  writer.add(TIME_KEY, 1700000000123ULL);
+  writer.add(CODE_KEY, "a\"", 2);
+  writer.endMap();
+  TEST_ASSERT_EQUAL(sizeof(EXPECTED), writer.length());
+  TEST_ASSERT_EQUAL_MEMORY(EXPECTED, buf, sizeof(EXPECTED));
+}
+
+static void test_overflow() {
+  char small[8];
+  PayloadWriter writer(small, sizeof(small), PAYLOAD_JSON);
+
+  writer.beginMap();
+  writer.add(CODE_KEY, "12345", 5);
+  writer.endMap();
+  TEST_ASSERT_TRUE(writer.overflow());
+  TEST_ASSERT_EQUAL(7, strlen(writer.c_str())); // Always terminated
+}
+
+static void test_benchmark() {
+  static const uint32_t ROUNDS = 100000;
+  static const payloadformat_t FORMATS[] = { PAYLOAD_RAW, PAYLOAD_JSON, PAYLOAD_CBOR };
+  static const char *const NAMES[] = { "raw", "json", "cbor" };
+
+  uint16_t sizes[3];
+
+  for (uint8_t f = 0; f < 3; ++f) {
+    uint32_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < ROUNDS; ++i)
+      bytes += encodeScan(FORMATS[f], i);
+
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+    char msg[80];
+
+    sizes[f] = encodeScan(FORMATS[f], 1000);
+    snprintf(msg, sizeof(msg), "%s: %.0f ns, %u bytes per scan (seq 1000)", NAMES[f], ns, sizes[f]);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(bytes > 0);
+  }
+  TEST_ASSERT_TRUE(sizes[2] < sizes[1]); // Same fields, CBOR is smaller on the wire
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_json);
+  RUN_TEST(test_cbor);
+  RUN_TEST(test_overflow);
+  RUN_TEST(test_benchmark);
+
+  return UNITY_END();
+}
@@ -0,0 +1,158 @@
+#include <chrono>
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+#include "Router.h"
+
+// Topic routing trie, templates and routes in config JSON
+
+static Router router;
+static char topic[Router::TOPIC_SIZE];
+
+static const char *route(const char *code, symbology_t symbology = SYM_UNKNOWN) {
+  return router.route(code, strlen(code), symbology, topic);
+}
+
+static void fillRoutes(Router &r, uint8_t count = Router::MAX_ROUTES) { // Longest allowed strings, what config document must hold
+  char prefix[Router::PREFIX_SIZE];
+  char t[Router::TOPIC_SIZE];
+
+  for (uint8_t i = 0; i < count; ++i) {
+    memset(prefix, '0' + i % 10, sizeof(prefix) - 1);
+    prefix[sizeof(prefix) - 1] = '\0';
+    prefix[0] = 'A' + i;
+    memset(t, 'a' + i, sizeof(t) - 1);
+    t[sizeof(t) - 1] = '\0';
+    memcpy(t, "{client}/{symbology}/", 21);
+    TEST_ASSERT_EQUAL(i, r.add(prefix, i, 200 + i, (i & 0x01) ? SYM_GS1_DATAMATRIX : SYM_ANY, t));
+  }
+}
+
+void setUp() {
+  router.clear();
+}
+
+void tearDown() {}
+
+static void test_trie() {
+  TEST_ASSERT_EQUAL(0, router.add(NULL, 0, 0, SYM_ANY, "all"));
+  TEST_ASSERT_EQUAL(1, router.add("40", 0, 0, SYM_ANY, "de"));
+  TEST_ASSERT_EQUAL(2, router.add("400", 13, 13, SYM_EAN13, "de/ean13"));
+  TEST_ASSERT_EQUAL(3, router.add("4", 8, 8, SYM_ANY, "short"));
+  TEST_ASSERT_TRUE(router.compile("dev1"));
+  TEST_ASSERT_EQUAL_STRING("de/ean13", route("4006381333931", SYM_EAN13)); // Deepest match wins
+  TEST_ASSERT_EQUAL_STRING("de", route("4006381333931", SYM_UPCA));
+  TEST_ASSERT_EQUAL_STRING("de", route("40063813"));
+  TEST_ASSERT_EQUAL_STRING("short", route("41234567"));
+  TEST_ASSERT_EQUAL_STRING("all", route("5901234123457"));
+}
+
+static void test_no_default() {
+  TEST_ASSERT_EQUAL(0, router.add("X", 0, 0, SYM_ANY, "x"));
+  TEST_ASSERT_TRUE(router.compile(NULL));
+  TEST_ASSERT_NULL(route("Y1"));
+  TEST_ASSERT_NULL(route(""));
+}
+
+static void test_templates() {
+  TEST_ASSERT_EQUAL(0, router.add(NULL, 0, 0, SYM_ANY, "scan/{client}/{symbology}/{prefix4}"));
+  TEST_ASSERT_EQUAL(1, router.add("L", 0, 0, SYM_ANY, "{client}/loc"));
+  TEST_ASSERT_TRUE(router.compile("dev1"));
+  TEST_ASSERT_EQUAL_STRING("scan/dev1/ean13/4006", route("4006381333931", SYM_EAN13));
+  TEST_ASSERT_EQUAL_STRING("scan/dev1/unknown/a_b_", route("a/b#c"));
+  TEST_ASSERT_EQUAL_STRING("scan/dev1/code128/12", route("12", SYM_CODE128));
+  TEST_ASSERT_EQUAL_STRING("dev1/loc", route("L01"));
+}
+
+static void test_limits() {
+  char s[Router::TOPIC_SIZE + 1];
+
+  memset(s, 'x', sizeof(s) - 1);
+  s[sizeof(s) - 1] = '\0';
+  TEST_ASSERT_EQUAL(Router::ERR_INDEX, router.add(NULL, 0, 0, SYM_ANY, s));
+  s[Router::PREFIX_SIZE] = '\0';
+  TEST_ASSERT_EQUAL(Router::ERR_INDEX, router.add(s, 0, 0, SYM_ANY, "t"));
+  TEST_ASSERT_EQUAL(Router::ERR_INDEX, router.add("1", 0, 0, SYM_ANY, ""));
+  fillRoutes(router);
+  TEST_ASSERT_EQUAL(Router::ERR_INDEX, router.add("1", 0, 0, SYM_ANY, "t"));
+  TEST_ASSERT_TRUE(router.compile("dev1"));
+}
+
+static void test_json_roundtrip() {
+  static const size_t CAPACITY = Router::MAX_ROUTES * Router::JSON_SIZE;
+
+  DynamicJsonDocument doc(CAPACITY);
+  Router loaded;
+
+  fillRoutes(router);
+  router.write(doc.to<JsonArray>());
+  TEST_ASSERT_FALSE(doc.overflowed());
+
+  std::string json(measureJson(doc) + 1, '\0');
+
+  serializeJson(doc, &json[0], json.size());
+
+  DynamicJsonDocument parsed(CAPACITY); // Like BaseConfig::load(), all strings are copied
+  DeserializationError error = deserializeJson(parsed, json.c_str());
+
+  TEST_ASSERT_FALSE_MESSAGE(error, error.c_str());
+  TEST_ASSERT_EQUAL(0, loaded.read(parsed.as<JsonArrayConst>()));
+  TEST_ASSERT_EQUAL(Router::MAX_ROUTES, loaded.count());
+  for (uint8_t i = 0; i < Router::MAX_ROUTES; ++i) {
+    TEST_ASSERT_EQUAL_STRING(router[i].prefix, loaded[i].prefix);
+    TEST_ASSERT_EQUAL_STRING(router[i].topic, loaded[i].topic);
+    TEST_ASSERT_EQUAL(router[i].minlen, loaded[i].minlen);
+    TEST_ASSERT_EQUAL(router[i].maxlen, loaded[i].maxlen);
+    TEST_ASSERT_EQUAL(router[i].symbology, loaded[i].symbology);
+  }
+  TEST_ASSERT_TRUE(loaded.compile("dev1"));
+}
+
+static void test_json_skips() {
+  DynamicJsonDocument doc(1024);
+
+  TEST_ASSERT_FALSE(deserializeJson(doc, "[{\"prefix\":\"1\",\"symbology\":\"ean-13\",\"topic\":\"a\"},"
+    "{\"prefix\":\"2\",\"symbology\":\"unknown\",\"topic\":\"b\"},{\"prefix\":\"3\",\"topic\":\"\"},{\"topic\":\"c\",\"min_len\":8}]"));
+  TEST_ASSERT_EQUAL(2, router.read(doc.as<JsonArrayConst>()));
+  TEST_ASSERT_EQUAL(2, router.count());
+  TEST_ASSERT_EQUAL(SYM_UNKNOWN, router[0].symbology);
+  TEST_ASSERT_EQUAL(SYM_ANY, router[1].symbology);
+  TEST_ASSERT_EQUAL(8, router[1].minlen);
+}
+
+static void test_benchmark() {
+  static const uint32_t ROUNDS = 100000;
+
+  uint32_t routed = 0;
+
+  fillRoutes(router, Router::MAX_ROUTES - 1);
+  TEST_ASSERT_EQUAL(Router::MAX_ROUTES - 1, router.add(NULL, 0, 0, SYM_ANY, "scan/{client}/{prefix4}"));
+  TEST_ASSERT_TRUE(router.compile("dev1"));
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < ROUNDS; ++i) {
+    if (route((i & 0x01) ? "4006381333931" : "E44444444444444444444444"))
+      ++routed;
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+  char msg[64];
+
+  snprintf(msg, sizeof(msg), "%.0f ns per routed scan, 16 routes", ns);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL(ROUNDS, routed);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_trie);
+  RUN_TEST(test_no_default);
+  RUN_TEST(test_templates);
+  RUN_TEST(test_limits);
+  RUN_TEST(test_json_roundtrip);
+  RUN_TEST(test_json_skips);
+  RUN_TEST(test_benchmark);
+
+  return UNITY_END();
+}
@@ -0,0 +1,140 @@
+#include <chrono>
+#include <Arduino.h>
+#include <unity.h>
+#include "Symbology.h"
+
+// Corpus of scanner output: AIM or GM65 Code ID prefixed, bare and damaged reads
+
+struct _sample_t {
+  const char *code;
+  uint8_t flags;
+  symbology_t symbology;
+  bool valid;
+};
+
+static const _sample_t CORPUS[] = {
+  { "]E04006381333931", 0, SYM_EAN13, true },
+  { "]E04006381333932", 0, SYM_EAN13, false },
+  { "]E496385074", 0, SYM_EAN8, true },
+  { "]E496385075", 0, SYM_EAN8, false },
+  { "]E0036000291452", 0, SYM_UPCA, true },
+  { "]E004252614", 0, SYM_UPCE, true },
+  { "]E004252615", 0, SYM_UPCE, false },
+  { "]E0123", 0, SYM_EAN13, false },
+  { "]E040063813339A1", 0, SYM_EAN13, false },
+  { "]I110012345678902", 0, SYM_ITF14, true },
+  { "]I110012345678903", 0, SYM_ITF14, false },
+  { "]I01234", 0, SYM_ITF, true },
+  { "]C0ABC-123", 0, SYM_CODE128, true },
+  { "]C012345678", 0, SYM_CODE128, true },
+  { "]C10100012345678905\x1d" "10ABC", 0, SYM_GS1_128, true },
+  { "]C10100012345678904", 0, SYM_GS1_128, false },
+  { "]C100006141411234567890", 0, SYM_GS1_128, true },
+  { "]C1X1", 0, SYM_GS1_128, false },
+  { "]A0CODE39", 0, SYM_CODE39, true },
+  { "]F0A123B", 0, SYM_CODABAR, true },
+  { "]Q1https://example.com", 0, SYM_QR, true },
+  { "]d2\x1d" "0100012345678905", 0, SYM_GS1_DATAMATRIX, true },
+  { "]d1DM", 0, SYM_DATAMATRIX, true },
+  { "]L0PDF", 0, SYM_PDF417, true },
+  { "04252614", 0, SYM_UNKNOWN, true }, // UPC-E without prefix is not mistaken for EAN-8
+  { "12345678", 0, SYM_UNKNOWN, true }, // Numeric Code 128
+  { "4006381333932", 0, SYM_UNKNOWN, true },
+  { "4006381333931", CLASSIFY_GUESS, SYM_EAN13, true },
+  { "4006381333932", CLASSIFY_GUESS, SYM_EAN13, false },
+  { "036000291452", CLASSIFY_GUESS, SYM_UPCA, true },
+  { "96385074", CLASSIFY_GUESS, SYM_EAN8, true },
+  { "10012345678902", CLASSIFY_GUESS, SYM_ITF14, true },
+  { "12345", CLASSIFY_GUESS, SYM_UNKNOWN, true },
+  { "ABC123", CLASSIFY_GUESS, SYM_UNKNOWN, true },
+  { "d4006381333931", CLASSIFY_CODE_ID, SYM_EAN13, true },
+  { "d4006381333932", CLASSIFY_CODE_ID, SYM_EAN13, false },
+  { "d96385074", CLASSIFY_CODE_ID, SYM_EAN8, true },
+  { "c036000291452", CLASSIFY_CODE_ID, SYM_UPCA, true },
+  { "c04252614", CLASSIFY_CODE_ID, SYM_UPCE, true },
+  { "e10012345678902", CLASSIFY_CODE_ID, SYM_ITF14, true },
+  { "e1234", CLASSIFY_CODE_ID, SYM_ITF, true },
+  { "jABC-123", CLASSIFY_CODE_ID, SYM_CODE128, true },
+  { "j\x1d" "0100012345678905", CLASSIFY_CODE_ID, SYM_GS1_128, true },
+  { "j\x1d" "0100012345678904", CLASSIFY_CODE_ID, SYM_GS1_128, false },
+  { "bCODE39", CLASSIFY_CODE_ID, SYM_CODE39, true },
+  { "aA123B", CLASSIFY_CODE_ID, SYM_CODABAR, true },
+  { "Qhttps://example.com", CLASSIFY_CODE_ID, SYM_QR, true },
+  { "u\x1d" "0100012345678905", CLASSIFY_CODE_ID, SYM_GS1_DATAMATRIX, true },
+  { "uDM", CLASSIFY_CODE_ID, SYM_DATAMATRIX, true },
+  { "rPDF", CLASSIFY_CODE_ID, SYM_PDF417, true },
+  { "iCODE93", CLASSIFY_CODE_ID, SYM_UNKNOWN, true }, // Letter of unsupported symbology
+  { "40063\x01" "81333931", 0, SYM_UNKNOWN, false }, // Line noise
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_corpus() {
+  for (uint8_t i = 0; i < sizeof(CORPUS) / sizeof(CORPUS[0]); ++i) {
+    barcodeinfo_t info;
+    char msg[64];
+    bool valid = classifyBarcode(CORPUS[i].code, strlen(CORPUS[i].code), &info, CORPUS[i].flags);
+
+    snprintf(msg, sizeof(msg), "Sample %u", i);
+    TEST_ASSERT_EQUAL_MESSAGE(CORPUS[i].symbology, info.symbology, msg);
+    TEST_ASSERT_EQUAL_MESSAGE(CORPUS[i].valid, valid, msg);
+    TEST_ASSERT_EQUAL_MESSAGE(valid, info.valid, msg);
+  }
+}
+
+static void test_offset() {
+  barcodeinfo_t info;
+
+  TEST_ASSERT_TRUE(classifyBarcode("]E04006381333931", 16, &info));
+  TEST_ASSERT_EQUAL(3, info.offset);
+  TEST_ASSERT_EQUAL(13, info.length);
+  TEST_ASSERT_TRUE(classifyBarcode("4006381333931", 13, &info));
+  TEST_ASSERT_EQUAL(0, info.offset);
+  TEST_ASSERT_EQUAL(13, info.length);
+  TEST_ASSERT_TRUE(classifyBarcode("iCODE93", 7, &info, CLASSIFY_CODE_ID));
+  TEST_ASSERT_EQUAL(1, info.offset);
+  TEST_ASSERT_EQUAL(6, info.length);
+}
+
+static void test_names() {
+  TEST_ASSERT_EQUAL_STRING("gs1_128", symbologyName(SYM_GS1_128));
+  TEST_ASSERT_EQUAL_STRING("unknown", symbologyName((symbology_t)200));
+  TEST_ASSERT_EQUAL(SYM_UPCE, symbologyFromName("upce"));
+  TEST_ASSERT_EQUAL(SYM_UNKNOWN, symbologyFromName("code93"));
+}
+
+static void test_benchmark() {
+  static const uint32_t ROUNDS = 20000;
+
+  uint32_t valid = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t r = 0; r < ROUNDS; ++r) {
+    for (uint8_t i = 0; i < sizeof(CORPUS) / sizeof(CORPUS[0]); ++i) {
+      barcodeinfo_t info;
+
+      if (classifyBarcode(CORPUS[i].code, strlen(CORPUS[i].code), &info, CORPUS[i].flags))
+        ++valid;
+    }
+  }
+
+  uint32_t codes = ROUNDS * (sizeof(CORPUS) / sizeof(CORPUS[0]));
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / codes;
+  char msg[64];
+
+  snprintf(msg, sizeof(msg), "%u codes, %.0f ns per code", codes, ns);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_TRUE(valid > 0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_corpus);
+  RUN_TEST(test_offset);
+  RUN_TEST(test_names);
+  RUN_TEST(test_benchmark);
+
+  return UNITY_END();
+}
@@ -0,0 +1,141 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <unity.h>
+#include "Transform.h"
+
+// Transform language compiled to bytecode and applied in place over a scan corpus
+
+static Transform transform;
+static char buf[256];
+
+static const char *apply(const char *program, const char *code) { // NULL if program is rejected
+  if (! transform.compile(program))
+    return NULL;
+  strcpy(buf, code);
+  transform.apply(buf, strlen(buf));
+
+  return buf;
+}
+
+void setUp() {
+  transform.clear();
+}
+
+void tearDown() {}
+
+static void test_ops() {
+  TEST_ASSERT_EQUAL_STRING("ABC12", apply("lstrip ]C1; remove ctrl; upper", "]C1abc\x1d" "12\r"));
+  TEST_ASSERT_EQUAL_STRING("4006381333931", apply("lstrip ]C1", "4006381333931")); // No prefix, unchanged
+  TEST_ASSERT_EQUAL_STRING("123", apply("rstrip \\r\\n", "123\r\n"));
+  TEST_ASSERT_EQUAL_STRING("123\n", apply("rstrip \\r\\n", "123\n"));
+  TEST_ASSERT_EQUAL_STRING("CDE", apply("substr 2 3", "ABCDEFG"));
+  TEST_ASSERT_EQUAL_STRING("FG", apply("substr 5", "ABCDEFG"));
+  TEST_ASSERT_EQUAL_STRING("", apply("substr 9", "ABCDEFG"));
+  TEST_ASSERT_EQUAL_STRING("abc-1", apply("lower", "ABC-1"));
+  TEST_ASSERT_EQUAL_STRING("123", apply("keep digit", "A1-B2 C3"));
+  TEST_ASSERT_EQUAL_STRING("A1B2C3", apply("remove space,punct", "A1-B2 C3"));
+  TEST_ASSERT_EQUAL_STRING("A1", apply("remove high", "A\xD0\x90" "1"));
+  TEST_ASSERT_EQUAL_STRING("A1_B2 C3", apply("replace - _", "A1-B2 C3"));
+  TEST_ASSERT_EQUAL_STRING("A1-B2C3", apply("replace \\s", "A1-B2 C3"));
+}
+
+static void test_escapes() {
+  TEST_ASSERT_EQUAL_STRING("C1X", apply("lstrip \\x5d", "]C1X"));
+  TEST_ASSERT_EQUAL_STRING("a,b", apply("replace \\; ,", "a;b"));
+  TEST_ASSERT_EQUAL_STRING("a/b", apply("replace \\\\ /", "a\\b"));
+  TEST_ASSERT_EQUAL_STRING("ab", apply("replace \\t", "a\tb"));
+}
+
+static void test_empty() {
+  TEST_ASSERT_TRUE(transform.compile(NULL));
+  TEST_ASSERT_TRUE(transform.empty());
+  TEST_ASSERT_TRUE(transform.compile(""));
+  TEST_ASSERT_TRUE(transform.empty());
+  TEST_ASSERT_TRUE(transform.compile(" ; ;"));
+  TEST_ASSERT_TRUE(transform.empty());
+  TEST_ASSERT_EQUAL_STRING("AB", apply("upper;", "ab")); // Trailing ';'
+}
+
+static void test_errors() {
+  static const char *const WRONG[] = {
+    "frobnicate", "lstrip", "lstrip a b", "upper x", "remove colour", "keep", "replace ab", "replace a bc",
+    "substr", "lstrip \\q", "lstrip \\x4", "lstrip 0123456789012345678901234567890123456789", "upper; lower x"
+  };
+
+  for (uint8_t i = 0; i < sizeof(WRONG) / sizeof(WRONG[0]); ++i) {
+    TEST_ASSERT_TRUE(transform.compile("upper"));
+    TEST_ASSERT_FALSE_MESSAGE(transform.compile(WRONG[i]), WRONG[i]);
+    TEST_ASSERT_TRUE_MESSAGE(transform.empty(), WRONG[i]); // Partially compiled program is not kept
+  }
+
+  std::string program;
+
+  for (uint8_t i = 0; i < Transform::SIZE; ++i) // Does not fit bytecode
+    program += "upper;";
+  TEST_ASSERT_FALSE(transform.compile(program.c_str()));
+  TEST_ASSERT_TRUE(transform.empty());
+}
+
+static void test_benchmark() {
+  static const uint32_t SCANS = 100000;
+  static const char PROGRAM[] = "lstrip ]E0; lstrip ]C1; rstrip \\r; remove ctrl; upper";
+
+  std::vector<std::string> corpus;
+  char code[64];
+  uint32_t bytes = 0, out = 0;
+
+  srand(1);
+  for (uint32_t i = 0; i < SCANS; ++i) { // Mix of AIM prefixed EAN-13 and GS1-128, lower case item codes and bare numbers
+    uint32_t r = rand();
+
+    switch (i % 4) {
+      case 0:
+        snprintf(code, sizeof(code), "]E04006%07u\r", r % 10000000);
+        break;
+      case 1:
+        snprintf(code, sizeof(code), "]C101000%09u\x1d" "10lot%u\r", r % 1000000000, r % 1000);
+        break;
+      case 2:
+        snprintf(code, sizeof(code), "item-%u/%c\r", r % 100000, 'a' + r % 26);
+        break;
+      default:
+        snprintf(code, sizeof(code), "%u", r);
+        break;
+    }
+    corpus.push_back(code);
+    bytes += corpus.back().size();
+  }
+  TEST_ASSERT_TRUE(transform.compile(PROGRAM));
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < SCANS; ++i) {
+    uint8_t len = corpus[i].size();
+
+    memcpy(buf, corpus[i].data(), len); // Like framer buffer
+    out += transform.apply(buf, len);
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / SCANS;
+  char msg[80];
+
+  snprintf(msg, sizeof(msg), "%u scans, %.0f ns per scan, %u of %u bytes left", SCANS, ns, out, bytes);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_TRUE(out < bytes);
+  strcpy(buf, "]C10100012345678905\x1d" "10lot1\r");
+  transform.apply(buf, strlen(buf));
+  TEST_ASSERT_EQUAL_STRING("0100012345678905" "10LOT1", buf);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ops);
+  RUN_TEST(test_escapes);
+  RUN_TEST(test_empty);
+  RUN_TEST(test_errors);
+  RUN_TEST(test_benchmark);
+
+  return UNITY_END();
+}
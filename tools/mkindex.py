@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Build lookup index file for MQTT BarScanner from CSV (barcode,value)."""
+
+import argparse
+import csv
+import struct
+
+MAGIC = 0x31584942  # "BIX1"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('csv', help='input CSV file, first column is barcode, second is value')
+    parser.add_argument('index', help='output index file (upload it to /lookup.idx)')
+    parser.add_argument('--page-size', type=int, default=512, help='page size in bytes (max 512)')
+    parser.add_argument('--key-size', type=int, default=0, help='key size (default: longest barcode)')
+    parser.add_argument('--value-size', type=int, default=0, help='value size (default: longest value)')
+    args = parser.parse_args()
+
+    records = {}
+    with open(args.csv, newline='', encoding='utf-8') as f:
+        for row in csv.reader(f):
+            if len(row) >= 2 and row[0]:
+                records[row[0].encode()] = row[1].encode()
+    if not records:
+        parser.error('no records')
+
+    keysize = args.key_size or max(len(k) for k in records)
+    valuesize = args.value_size or max(len(v) for v in records.values())
+    if keysize > 255 or valuesize > 255 or keysize + valuesize > args.page_size or args.page_size > 512:
+        parser.error('record does not fit page')
+    if args.page_size // keysize < 2:
+        parser.error('index page must hold at least 2 keys, increase page size or decrease key size')
+    for k, v in records.items():
+        if len(k) > keysize or len(v) > valuesize:
+            parser.error('record %r is too long' % k)
+
+    keys = sorted(records)
+    perpage = args.page_size // (keysize + valuesize)
+    pages = [keys[i:i + perpage] for i in range(0, len(keys), perpage)]
+    perindex = args.page_size // keysize
+
+    def page(data):
+        return data.ljust(args.page_size, b'\0')
+
+    with open(args.index, 'wb') as f:
+        f.write(page(struct.pack('<IHBBI', MAGIC, args.page_size, keysize, valuesize, len(keys))))
+        # Static B-tree levels: first key of every page of the level below, written from the root down
+        levels = []
+        firsts = [p[0].ljust(keysize, b'\0') for p in pages]
+        while len(firsts) > 1:
+            level = [b''.join(firsts[i:i + perindex]) for i in range(0, len(firsts), perindex)]
+            levels.append(level)
+            firsts = [firsts[i] for i in range(0, len(firsts), perindex)]
+        for level in reversed(levels):
+            for p in level:
+                f.write(page(p))
+        for p in pages:
+            f.write(page(b''.join(k.ljust(keysize, b'\0') + records[k].ljust(valuesize, b'\0') for k in p)))
+
+    print('%d record(s), %d data page(s), %d index level(s), key %d, value %d byte(s)' %
+          (len(keys), len(pages), len(levels), keysize, valuesize))
+
+
+if __name__ == '__main__':
+    main()
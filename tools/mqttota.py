@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Push firmware image to MQTT BarScanner over MQTT (mqtt_ota_topic), resuming from acked offset."""
+
+import argparse
+import hashlib
+import json
+import queue
+import struct
+import sys
+import time
+
+import paho.mqtt.client as mqtt  # pip install paho-mqtt
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('image', help='firmware .bin or .bin.gz (needs 3.x core on device)')
+    parser.add_argument('--host', default='localhost', help='MQTT broker')
+    parser.add_argument('--port', type=int, default=1883, help='MQTT broker port')
+    parser.add_argument('--user', help='MQTT user')
+    parser.add_argument('--pswd', help='MQTT password')
+    parser.add_argument('--topic', default='/ota', help='device mqtt_ota_topic')
+    parser.add_argument('--chunk', type=int, default=1024, help='image bytes per message')
+    parser.add_argument('--window', type=int, default=4096, help='bytes sent before waiting for ack')
+    parser.add_argument('--timeout', type=float, default=10, help='ack timeout in seconds')
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    begin = json.dumps({'size': len(image), 'md5': hashlib.md5(image).hexdigest(), 'window': args.window})
+
+    acks = queue.Queue()
+    if hasattr(mqtt, 'CallbackAPIVersion'):  # paho-mqtt 2.x
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION1)
+    else:
+        client = mqtt.Client()
+    if args.user:
+        client.username_pw_set(args.user, args.pswd)
+    client.on_connect = lambda c, userdata, flags, rc: c.subscribe(args.topic + '/ack', 1)
+    client.on_message = lambda c, userdata, msg: acks.put(json.loads(msg.payload))
+    client.connect(args.host, args.port)
+    client.loop_start()
+
+    start = time.time()
+    retries = 0
+    client.publish(args.topic + '/begin', begin, 1)
+    while True:
+        try:
+            ack = acks.get(timeout=args.timeout)
+        except queue.Empty:  # Lost ack or device reconnecting, ask it for current offset
+            retries += 1
+            client.publish(args.topic + '/begin', begin, 1)
+            continue
+        while not acks.empty():  # Newest state wins
+            ack = acks.get()
+        state, offset = ack.get('state'), ack.get('offset', 0)
+        if state == 'done':
+            elapsed = time.time() - start
+            print('\nUpdated %u byte(s) in %.1f s (%.1f KB/s, device %u ms), %u retries' % (
+                len(image), elapsed, len(image) / elapsed / 1024, ack.get('ms', 0), retries), flush=True)
+            return 0
+        if state != 'running':
+            print('\nUpdate %s, error %s' % (state, ack.get('error')), file=sys.stderr)
+            return 1
+        print('\r%u/%u' % (offset, len(image)), end='', flush=True)
+        end = min(offset + args.window, len(image))
+        while offset < end:
+            client.publish(args.topic + '/data', struct.pack('>I', offset) + image[offset:offset + args.chunk], 1)
+            offset += args.chunk
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Receive MQTT BarScanner UDP datagrams, ack them and report loss and latency."""
+
+import argparse
+import socket
+import struct
+import time
+
+HEADER = struct.Struct('>2sBBIQB')  # 'BS', version, flags, seq, time (ms), idlen
+FLAG_ACK = 0x01
+FLAG_SYNCED = 0x02
+
+
+class Device:
+    def __init__(self):
+        self.last = None
+        self.received = 0
+        self.lost = 0
+        self.duplicates = 0
+        self.latencies = []
+
+    def update(self, seq, latency):
+        if seq == 1:
+            self.last = None  # Device restarted
+        if self.last is not None and seq <= self.last:
+            self.duplicates += 1  # Retransmit of already received datagram
+            return False
+        if self.last is not None:
+            self.lost += seq - self.last - 1
+        self.last = seq
+        self.received += 1
+        if latency is not None:
+            self.latencies.append(latency)
+        return True
+
+    def report(self, name):
+        line = '%s: received %u, lost %u, duplicates %u' % (name, self.received, self.lost, self.duplicates)
+        if self.latencies:
+            lat = sorted(self.latencies)
+            line += ', latency ms p50 %.1f p99 %.1f max %.1f' % (
+                lat[len(lat) // 2], lat[min(len(lat) - 1, len(lat) * 99 // 100)], lat[-1])
+        print(line, flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--port', type=int, default=5000, help='UDP port (udp_port)')
+    parser.add_argument('--group', help='multicast group to join (udp_server), omit for unicast')
+    parser.add_argument('--interval', type=float, default=10, help='report interval in seconds')
+    parser.add_argument('--quiet', action='store_true', help='do not print every barcode')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(('', args.port))
+    if args.group:
+        mreq = struct.pack('4s4s', socket.inet_aton(args.group), socket.inet_aton('0.0.0.0'))
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    sock.settimeout(1)
+
+    devices = {}
+    next_report = time.time() + args.interval
+    while True:
+        try:
+            data, addr = sock.recvfrom(2048)
+        except socket.timeout:
+            data = None
+        now = time.time()
+        if data and len(data) >= HEADER.size:
+            magic, version, flags, seq, stamp, idlen = HEADER.unpack_from(data)
+            if magic == b'BS' and version == 1 and len(data) >= HEADER.size + idlen:
+                device = data[HEADER.size:HEADER.size + idlen].decode(errors='replace') or addr[0]
+                payload = data[HEADER.size + idlen:]
+                if flags & FLAG_ACK:
+                    sock.sendto(b'BA' + struct.pack('>I', seq), addr)
+                latency = now * 1000 - stamp if flags & FLAG_SYNCED else None  # Needs NTP synced host
+                if devices.setdefault(device, Device()).update(seq, latency) and not args.quiet:
+                    print('%s #%u: %s' % (device, seq, payload.decode(errors='replace')), flush=True)
+        if now >= next_report:
+            for name, device in sorted(devices.items()):
+                device.report(name)
+            next_report = now + args.interval
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Upload generated files to MQTT BarScanner web portal (/spiffs) and report throughput."""
+
+import argparse
+import base64
+import http.client
+import os
+import sys
+import time
+
+BOUNDARY = 'uploadbench'
+
+
+def upload(args, name, data):
+    body = ('--%s\r\nContent-Disposition: form-data; name="upload"; filename="%s"\r\n'
+            'Content-Type: application/octet-stream\r\n\r\n' % (BOUNDARY, name)).encode() + data + \
+        ('\r\n--%s--\r\n' % BOUNDARY).encode()
+    headers = {'Content-Type': 'multipart/form-data; boundary=' + BOUNDARY}
+    if args.user:
+        headers['Authorization'] = 'Basic ' + base64.b64encode(('%s:%s' % (args.user, args.pswd or '')).encode()).decode()
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    start = time.time()
+    conn.request('POST', '/spiffs', body, headers)
+    response = conn.getresponse()
+    reply = response.read().decode(errors='replace')
+    elapsed = time.time() - start
+    conn.close()
+    return response.status, reply, elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--host', default='192.168.4.1', help='device address')
+    parser.add_argument('--port', type=int, default=80, help='HTTP port')
+    parser.add_argument('--user', help='portal user (USE_AUTHORIZATION)')
+    parser.add_argument('--pswd', help='portal password')
+    parser.add_argument('--size', type=int, default=65536, help='file size in bytes')
+    parser.add_argument('--count', type=int, default=5, help='number of uploads')
+    parser.add_argument('--name', default='bench.bin', help='file name on device (overwritten every upload)')
+    parser.add_argument('--timeout', type=float, default=60, help='request timeout in seconds')
+    args = parser.parse_args()
+
+    data = os.urandom(args.size)
+    speeds = []
+    for i in range(args.count):
+        status, reply, elapsed = upload(args, args.name, data)
+        if status != 200:
+            print('Upload %u failed: %u %s' % (i + 1, status, reply.strip()), file=sys.stderr)
+            return 1
+        speeds.append(args.size / elapsed / 1024)
+        print('Upload %u: %u byte(s) in %.2f s (%.1f KB/s)' % (i + 1, args.size, elapsed, speeds[-1]), flush=True)
+    speeds.sort()
+    print('KB/s min %.1f median %.1f max %.1f' % (speeds[0], speeds[len(speeds) // 2], speeds[-1]))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())